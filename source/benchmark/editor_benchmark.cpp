@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "imgui.h"
+#include "editor/editor.hpp"
+
+// Frame timings of the editor in a headless ImGui context, without a window
+// or a renderer, so the grid is drawn with the CPU path of the canvas. Every
+// combination of grid size, alphabet size and stack depth is measured with
+// the whole grid in view and zoomed in far enough for the cell labels.
+
+using namespace gs;
+
+namespace
+{
+    struct options
+    {
+        std::vector<int> sizes = {256, 1024, 4096};
+        std::vector<int> symbols = {4, 16};
+        std::vector<int> stages = {4, 32};
+        int frames = 120;
+        int warmup = 5;
+        bool csv = false;
+    };
+
+    struct frame_sample
+    {
+        double cpu_ms;
+        double wall_ms;
+        int vertices;
+        int indices;
+    };
+
+    std::vector<int> parse_list(const char* text)
+    {
+        std::vector<int> values;
+        std::stringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            values.push_back(std::atoi(item.c_str()));
+        return values;
+    }
+
+    void print_usage(const char* program)
+    {
+        printf("Usage: %s [options]\n", program);
+        printf("  --sizes a,b,...    Grid sides in cells (default 256,1024,4096)\n");
+        printf("  --symbols a,b,...  Alphabet sizes (default 4,16)\n");
+        printf("  --stages a,b,...   Stack depths (default 4,32)\n");
+        printf("  --frames n         Measured frames per case (default 120)\n");
+        printf("  --csv              Print comma separated values\n");
+    }
+
+    // Random grid and a stack alternating random and rule-based stages
+    grid_synth make_project(int size, int symbols, int stages, std::mt19937& rng)
+    {
+        grid_synth synth(size, size, alphabet::empty_symbol.id);
+        for (int id = 1; id <= symbols; ++id)
+            synth.get_alphabet()->add_symbol({id, "S" + std::to_string(id)});
+
+        std::uniform_int_distribution<int> symbol(0, symbols);
+        grid& g = synth.get_grid();
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                g(x, y) = symbol(rng);
+
+        for (int i = 0; i < stages; ++i) {
+            if (i % 2 == 0) {
+                synth.add_transformation(std::make_unique<random_transformation>("Random " + std::to_string(i), synth.get_alphabet()));
+                continue;
+            }
+            auto rule = std::make_unique<rule_based_transformation>("Rule " + std::to_string(i), synth.get_alphabet());
+            grid search(3, 3, alphabet::wildcard_symbol.id);
+            grid replacement(3, 3, alphabet::wildcard_symbol.id);
+            search(1, 1) = symbol(rng);
+            replacement(1, 1) = symbol(rng);
+            rule->set_search(search);
+            rule->add_replacement(1.0f, replacement);
+            synth.add_transformation(std::move(rule));
+        }
+        return synth;
+    }
+
+    // Tell ImGui the font atlas was uploaded, there is no renderer to do it
+    void finish_textures()
+    {
+#if IMGUI_VERSION_NUM >= 19200
+        for (ImTextureData* tex : ImGui::GetPlatformIO().Textures) {
+            if (tex->Status == ImTextureStatus_WantCreate || tex->Status == ImTextureStatus_WantUpdates) {
+                tex->SetTexID((ImTextureID)1);
+                tex->SetStatus(ImTextureStatus_OK);
+            } else if (tex->Status == ImTextureStatus_WantDestroy) {
+                tex->SetTexID(ImTextureID_Invalid);
+                tex->SetStatus(ImTextureStatus_Destroyed);
+            }
+        }
+#endif
+    }
+
+    frame_sample run_frame(editor& e, float wheel)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        io.DeltaTime = 1.0f / 60.0f;
+
+        // The canvas takes the rest of the Synthesizer window
+        const ImVec2 window_pos(400.0f, 0.0f);
+        const ImVec2 window_size(io.DisplaySize.x - window_pos.x, io.DisplaySize.y);
+        io.AddMousePosEvent(window_pos.x + window_size.x * 0.5f, window_pos.y + window_size.y * 0.6f);
+        if (wheel != 0.0f)
+            io.AddMouseWheelEvent(0.0f, wheel);
+
+        std::clock_t cpu_start = std::clock();
+        auto wall_start = std::chrono::steady_clock::now();
+
+        ImGui::NewFrame();
+        ImGui::SetWindowPos("Synthesizer", window_pos, ImGuiCond_Always);
+        ImGui::SetWindowSize("Synthesizer", window_size, ImGuiCond_Always);
+        e.edit();
+        ImGui::Render();
+
+        std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - wall_start;
+        double cpu = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        finish_textures();
+
+        const ImDrawData* draw_data = ImGui::GetDrawData();
+        return {cpu, wall.count(), draw_data->TotalVtxCount, draw_data->TotalIdxCount};
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+    }
+
+    void report(const options& opt, const char* view, int size, int symbols, int stages,
+                const std::vector<frame_sample>& samples)
+    {
+        std::vector<double> wall;
+        double cpu = 0.0, vertices = 0.0, indices = 0.0;
+        for (const auto& s : samples) {
+            wall.push_back(s.wall_ms);
+            cpu += s.cpu_ms;
+            vertices += s.vertices;
+            indices += s.indices;
+        }
+        const double n = (double)samples.size();
+        const char* format = opt.csv
+            ? "%d,%d,%d,%s,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f\n"
+            : "%6d %7d %6d  %-5s %9.3f %9.3f %9.3f %9.3f %10.0f %10.0f\n";
+        printf(format, size, symbols, stages, view, cpu / n, percentile(wall, 0.5), percentile(wall, 0.95),
+               percentile(wall, 1.0), vertices / n, indices / n);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            opt.sizes = parse_list(argv[++i]);
+        } else if (arg == "--symbols" && i + 1 < argc) {
+            opt.symbols = parse_list(argv[++i]);
+        } else if (arg == "--stages" && i + 1 < argc) {
+            opt.stages = parse_list(argv[++i]);
+        } else if (arg == "--frames" && i + 1 < argc) {
+            opt.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--csv") {
+            opt.csv = true;
+        } else {
+            print_usage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Headless context, the size of a common monitor
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+#if IMGUI_VERSION_NUM >= 19200
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+#else
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+#endif
+
+    if (opt.csv)
+        printf("size,symbols,stages,view,cpu_ms,p50_ms,p95_ms,max_ms,vertices,indices\n");
+    else
+        printf("  size symbols stages  view     cpu ms    p50 ms    p95 ms    max ms   vertices    indices\n");
+
+    {
+        editor e(nullptr);
+        for (int i = 0; i < opt.warmup; ++i)
+            run_frame(e, 0.0f);
+
+        std::mt19937 rng(1234);
+        for (int size : opt.sizes) {
+            for (int symbols : opt.symbols) {
+                for (int stages : opt.stages) {
+                    e.set_document(make_project(size, symbols, stages, rng));
+
+                    // Whole grid in view, then zoomed in around the center
+                    const struct { const char* name; float wheel; } views[] = {{"fit", 0.0f}, {"zoom", 30.0f}};
+                    for (const auto& view : views) {
+                        run_frame(e, view.wheel);
+                        for (int i = 0; i < opt.warmup; ++i)
+                            run_frame(e, 0.0f);
+
+                        std::vector<frame_sample> samples;
+                        for (int i = 0; i < opt.frames; ++i)
+                            samples.push_back(run_frame(e, 0.0f));
+                        report(opt, view.name, size, symbols, stages, samples);
+                    }
+                }
+            }
+        }
+    }
+
+    ImGui::DestroyContext();
+    return 0;
+}
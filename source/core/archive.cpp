@@ -0,0 +1,346 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "archive.hpp"
+#include "grid_io.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace gs;
+
+namespace
+{
+    const char header_magic[4] = {'G', 'S', 'A', '1'};
+    const char index_magic[4] = {'G', 'S', 'A', 'X'};
+    const char footer_magic[4] = {'G', 'S', 'A', 'E'};
+
+    const size_t header_size = 8;           // magic + reserved
+    const size_t footer_size = 12;          // index offset + magic
+    const size_t index_entry_size = 36;     // seed, offset, length, seconds, width, height
+
+    void put_u32(std::vector<uint8_t>& out, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    void put_u64(std::vector<uint8_t>& out, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    uint32_t get_u32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t)p[i] << (8 * i);
+        return v;
+    }
+
+    uint64_t get_u64(const uint8_t* p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= (uint64_t)p[i] << (8 * i);
+        return v;
+    }
+
+    std::vector<uint8_t> encode_index(const std::vector<archive_entry>& index)
+    {
+        std::vector<uint8_t> out(index_magic, index_magic + 4);
+        put_u64(out, index.size());
+        for (const auto& e : index) {
+            uint32_t seconds_bits;
+            std::memcpy(&seconds_bits, &e.seconds, 4);
+            put_u64(out, e.seed);
+            put_u64(out, e.offset);
+            put_u64(out, e.length);
+            put_u32(out, seconds_bits);
+            put_u32(out, (uint32_t)e.width);
+            put_u32(out, (uint32_t)e.height);
+        }
+        return out;
+    }
+
+    /// Parse the footer and index out of the last bytes of an archive. The
+    /// callback reads a range of the file.
+    template <typename Read>
+    std::vector<archive_entry> decode_index(uint64_t file_size, Read read)
+    {
+        if (file_size < header_size + footer_size)
+            throw std::runtime_error("File too small to be an archive");
+
+        uint8_t header[header_size];
+        read(0, header, header_size);
+        if (std::memcmp(header, header_magic, 4) != 0)
+            throw std::runtime_error("Not an archive");
+
+        uint8_t footer[footer_size];
+        read(file_size - footer_size, footer, footer_size);
+        if (std::memcmp(footer + 8, footer_magic, 4) != 0)
+            throw std::runtime_error("Archive has no index, it was not finished");
+
+        // Compared without sums, a corrupt offset near UINT64_MAX would wrap them
+        uint64_t index_offset = get_u64(footer);
+        const uint64_t index_end = file_size - footer_size;
+        if (index_offset < header_size || index_end - header_size < 12 || index_offset > index_end - 12)
+            throw std::runtime_error("Invalid archive index offset");
+
+        uint8_t index_header[12];
+        read(index_offset, index_header, 12);
+        if (std::memcmp(index_header, index_magic, 4) != 0)
+            throw std::runtime_error("Invalid archive index");
+
+        uint64_t count = get_u64(index_header + 4);
+        if (count > (file_size - footer_size - index_offset - 12) / index_entry_size)
+            throw std::runtime_error("Invalid archive index size");
+
+        std::vector<uint8_t> raw(count * index_entry_size);
+        if (count > 0)
+            read(index_offset + 12, raw.data(), raw.size());
+
+        std::vector<archive_entry> index(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            const uint8_t* p = raw.data() + i * index_entry_size;
+            archive_entry& e = index[i];
+            e.seed = get_u64(p);
+            e.offset = get_u64(p + 8);
+            e.length = get_u64(p + 16);
+            uint32_t seconds_bits = get_u32(p + 24);
+            std::memcpy(&e.seconds, &seconds_bits, 4);
+            e.width = (int32_t)get_u32(p + 28);
+            e.height = (int32_t)get_u32(p + 32);
+        }
+        return index;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            archive_writer
+////////////////////////////////////////////////////////////////////////////////
+
+archive_writer::archive_writer(const std::string& filename)
+    : m_filename(filename)
+{
+    uint64_t file_size = 0;
+#ifdef _WIN32
+    m_file = std::fopen(filename.c_str(), "r+b");
+    if (!m_file)
+        m_file = std::fopen(filename.c_str(), "w+b");
+    if (!m_file)
+        throw std::runtime_error("Could not open archive for writing: " + filename);
+    _fseeki64(m_file, 0, SEEK_END);
+    file_size = (uint64_t)_ftelli64(m_file);
+    auto read = [this](uint64_t offset, void* data, size_t size) {
+        _fseeki64(m_file, (long long)offset, SEEK_SET);
+        if (std::fread(data, 1, size, m_file) != size)
+            throw std::runtime_error("Failed to read archive");
+    };
+#else
+    m_fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0)
+        throw std::runtime_error("Could not open archive for writing: " + filename);
+    struct stat st;
+    if (::fstat(m_fd, &st) == 0)
+        file_size = (uint64_t)st.st_size;
+    auto read = [this](uint64_t offset, void* data, size_t size) {
+        if (::pread(m_fd, data, size, (off_t)offset) != (ssize_t)size)
+            throw std::runtime_error("Failed to read archive");
+    };
+#endif
+
+    try {
+        if (file_size == 0) {
+            uint8_t header[header_size] = {};
+            std::memcpy(header, header_magic, 4);
+            write_at(0, header, header_size);
+            file_size = header_size;
+        }
+        else {
+            m_index = decode_index(file_size, read);
+        }
+    }
+    catch (...) {
+#ifdef _WIN32
+        std::fclose(m_file);
+#else
+        ::close(m_fd);
+#endif
+        throw;
+    }
+
+    // New entries go after everything that is already in the file
+    m_end = file_size;
+}
+
+archive_writer::~archive_writer()
+{
+    try {
+        finish();
+    }
+    catch (...) {
+        // Destructors must not throw, the archive is left without an index
+    }
+}
+
+void archive_writer::write_at(uint64_t offset, const void* data, size_t size)
+{
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    _fseeki64(m_file, (long long)offset, SEEK_SET);
+    if (std::fwrite(data, 1, size, m_file) != size)
+        throw std::runtime_error("Failed to write archive: " + m_filename);
+#else
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = ::pwrite(m_fd, bytes, size, (off_t)offset);
+        if (written <= 0)
+            throw std::runtime_error("Failed to write archive: " + m_filename);
+        bytes += written;
+        offset += (uint64_t)written;
+        size -= (size_t)written;
+    }
+#endif
+}
+
+void archive_writer::append(uint64_t seed, const grid& g, float seconds)
+{
+    std::vector<uint8_t> data = compress_grid(g);
+
+    // Reserve a byte range, then write it without holding any lock
+    uint64_t offset = m_end.fetch_add(data.size());
+    write_at(offset, data.data(), data.size());
+
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    m_index.push_back({seed, offset, (uint64_t)data.size(), seconds, g.width(), g.height()});
+}
+
+void archive_writer::finish()
+{
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    if (m_finished)
+        return;
+    m_finished = true;
+
+    uint64_t index_offset = m_end;
+    std::vector<uint8_t> tail = encode_index(m_index);
+    put_u64(tail, index_offset);
+    tail.insert(tail.end(), footer_magic, footer_magic + 4);
+    write_at(index_offset, tail.data(), tail.size());
+
+#ifdef _WIN32
+    std::fclose(m_file);
+    m_file = nullptr;
+#else
+    ::close(m_fd);
+    m_fd = -1;
+#endif
+}
+
+size_t archive_writer::size() const
+{
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    return m_index.size();
+}
+
+batch_sink gs::archive_sink(archive_writer& writer)
+{
+    return [&writer](const batch_result& result) {
+        try {
+            writer.append(result.seed, result.output, (float)result.seconds);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error writing archive: " << e.what() << std::endl;
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            archive_reader
+////////////////////////////////////////////////////////////////////////////////
+
+archive_reader::archive_reader(const std::string& filename)
+{
+#ifdef _WIN32
+    m_stream.open(filename, std::ios::binary | std::ios::ate);
+    if (!m_stream.is_open())
+        throw std::runtime_error("Could not open archive: " + filename);
+    m_size = (uint64_t)m_stream.tellg();
+    m_index = decode_index(m_size, [this](uint64_t offset, void* data, size_t size) {
+        m_stream.seekg((std::streamoff)offset);
+        m_stream.read(static_cast<char*>(data), (std::streamsize)size);
+        if (!m_stream)
+            throw std::runtime_error("Failed to read archive");
+    });
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open archive: " + filename);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Could not read archive: " + filename);
+    }
+    m_size = (uint64_t)st.st_size;
+    void* mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Could not map archive: " + filename);
+    m_data = static_cast<const uint8_t*>(mapping);
+
+    try {
+        m_index = decode_index(m_size, [this](uint64_t offset, void* data, size_t size) {
+            std::memcpy(data, m_data + offset, size);
+        });
+    }
+    catch (...) {
+        ::munmap(const_cast<uint8_t*>(m_data), m_size);
+        throw;
+    }
+#endif
+
+    // Later entries win when a seed was appended more than once
+    m_by_seed.reserve(m_index.size());
+    for (size_t i = 0; i < m_index.size(); ++i)
+        m_by_seed[m_index[i].seed] = i;
+}
+
+archive_reader::~archive_reader()
+{
+#ifndef _WIN32
+    if (m_data)
+        ::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+}
+
+const archive_entry* archive_reader::find(uint64_t seed) const
+{
+    auto it = m_by_seed.find(seed);
+    return it != m_by_seed.end() ? &m_index[it->second] : nullptr;
+}
+
+grid archive_reader::load(const archive_entry& entry) const
+{
+    if (entry.offset < header_size || entry.length > m_size || entry.offset > m_size - entry.length)
+        throw std::runtime_error("Archive entry out of range");
+
+#ifdef _WIN32
+    std::vector<uint8_t> data(entry.length);
+    {
+        std::lock_guard<std::mutex> lock(m_stream_mutex);
+        m_stream.seekg((std::streamoff)entry.offset);
+        m_stream.read(reinterpret_cast<char*>(data.data()), (std::streamsize)entry.length);
+        if (!m_stream)
+            throw std::runtime_error("Failed to read archive entry");
+    }
+    return decompress_grid(data.data(), data.size());
+#else
+    return decompress_grid(m_data + entry.offset, entry.length);
+#endif
+}
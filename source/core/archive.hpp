@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "batch.hpp"
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            archive_entry
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Index record of one grid stored in an archive
+struct archive_entry
+{
+    uint64_t seed;          ///< Seed the grid was synthesized with
+    uint64_t offset;        ///< Byte offset of the compressed grid in the file
+    uint64_t length;        ///< Length of the compressed grid in bytes
+    float seconds;          ///< Time spent synthesizing the grid
+    int32_t width;          ///< Width of the grid
+    int32_t height;         ///< Height of the grid
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////                            archive_writer
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Appends compressed grids to a single archive file
+///
+/// The file starts with a small header, followed by the grids in the
+/// compressed grid format and ends with an index of all entries and a footer
+/// pointing at the index. Appends are safe to call from many threads at once:
+/// each one reserves its byte range with an atomic add and then writes it
+/// without holding a lock. The index is written when the archive is finished.
+///
+/// Opening an existing archive keeps its entries; new grids go after the old
+/// index and a new index covering everything is written at the end.
+class archive_writer
+{
+public:
+    /// @brief Open or create an archive
+    /// @param filename Path to the archive file
+    /// @throws std::runtime_error if the file can't be opened or is not an archive
+    explicit archive_writer(const std::string& filename);
+
+    /// @brief Destructor, finishes the archive if needed
+    ~archive_writer();
+
+    archive_writer(const archive_writer&) = delete;
+    archive_writer& operator=(const archive_writer&) = delete;
+
+    /// @brief Append a grid
+    /// @param seed Seed the grid was synthesized with
+    /// @param g The grid
+    /// @param seconds Time spent synthesizing the grid
+    /// @note Thread safe
+    void append(uint64_t seed, const grid& g, float seconds = 0.0f);
+
+    /// @brief Write the index and close the file
+    void finish();
+
+    /// @brief Get the number of entries
+    /// @return The number of entries, including ones from before opening
+    size_t size() const;
+
+private:
+    /// @brief Write bytes at an offset
+    void write_at(uint64_t offset, const void* data, size_t size);
+
+    std::string m_filename;
+    std::atomic<uint64_t> m_end{0};
+    mutable std::mutex m_index_mutex;
+    std::vector<archive_entry> m_index;
+    bool m_finished = false;
+#ifdef _WIN32
+    std::mutex m_file_mutex;
+    std::FILE* m_file = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+/// @brief Create a batch sink that appends every result to an archive
+///
+/// Appends reserve their own byte range, so the workers write in parallel.
+/// The archive is not finished by the sink.
+/// @param writer The archive, must outlive the batch
+/// @return The sink
+batch_sink archive_sink(archive_writer& writer);
+
+////////////////////////////////////////////////////////////////////////////////
+////                            archive_reader
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Random access to the grids stored in an archive
+///
+/// The file is memory mapped and the index is read once, so loading any
+/// entry is a lookup plus decompressing its bytes straight from the mapping.
+/// Where mmap is not available it falls back to one seek and read per load.
+class archive_reader
+{
+public:
+    /// @brief Open an archive
+    /// @param filename Path to the archive file
+    /// @throws std::runtime_error if the file can't be opened or is not an archive
+    explicit archive_reader(const std::string& filename);
+
+    /// @brief Destructor
+    ~archive_reader();
+
+    archive_reader(const archive_reader&) = delete;
+    archive_reader& operator=(const archive_reader&) = delete;
+
+    /// @brief Get the number of entries
+    /// @return The number of entries
+    size_t size() const { return m_index.size(); }
+
+    /// @brief Get all entries
+    /// @return The index, in the order the grids were appended
+    const std::vector<archive_entry>& entries() const { return m_index; }
+
+    /// @brief Find the entry for a seed
+    /// @param seed The seed
+    /// @return The entry, or nullptr if the seed is not in the archive
+    const archive_entry* find(uint64_t seed) const;
+
+    /// @brief Load the grid of an entry
+    /// @param entry The entry, as returned by entries() or find()
+    /// @return The grid
+    /// @throws std::runtime_error if the entry is out of range or corrupt
+    grid load(const archive_entry& entry) const;
+
+private:
+    std::vector<archive_entry> m_index;
+    std::unordered_map<uint64_t, size_t> m_by_seed;
+    uint64_t m_size = 0;
+#ifdef _WIN32
+    mutable std::mutex m_stream_mutex;
+    mutable std::ifstream m_stream;
+#else
+    const uint8_t* m_data = nullptr;
+#endif
+};
+
+}
@@ -0,0 +1,39 @@
+#include "background_task.hpp"
+
+using namespace gs;
+
+background_task::~background_task()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool background_task::start(std::string label, work_fn work, done_fn done)
+{
+    if (busy())
+        return false;
+
+    m_label = std::move(label);
+    m_done = std::move(done);
+    m_progress = 0.0f;
+    m_finished = false;
+    m_thread = std::thread([this, work = std::move(work)]() {
+        work(m_progress);
+        m_progress = 1.0f;
+        m_finished = true;
+    });
+    return true;
+}
+
+bool background_task::poll()
+{
+    if (!m_thread.joinable() || !m_finished)
+        return false;
+
+    m_thread.join();
+    done_fn done = std::move(m_done);
+    m_done = nullptr;
+    if (done)
+        done();
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                          background_task
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Runs one piece of work on its own thread
+///
+/// The work reports its progress through an atomic the owner can read at
+/// any time. When it is done, the completion callback runs on the thread
+/// that calls poll(), so it can safely touch state owned by that thread,
+/// such as swapping in a loaded document between two UI frames.
+class background_task
+{
+public:
+    /// @brief Work to run, receives the progress to update, between 0 and 1
+    using work_fn = std::function<void(std::atomic<float>& progress)>;
+
+    /// @brief Called from poll() once the work has finished
+    using done_fn = std::function<void()>;
+
+    /// @brief Constructor
+    background_task() = default;
+
+    /// @brief Destructor, waits for the running work to finish
+    ~background_task();
+
+    background_task(const background_task&) = delete;
+    background_task& operator=(const background_task&) = delete;
+
+    /// @brief Start work, if none is running
+    /// @param label Description shown while the work runs
+    /// @param work The work, run on a new thread
+    /// @param done Completion callback, run by poll() on the owner's thread
+    /// @return False if other work is still running
+    bool start(std::string label, work_fn work, done_fn done);
+
+    /// @brief Run the completion callback if the work has finished
+    /// @return True if the callback ran
+    bool poll();
+
+    /// @brief Check if work is running or waiting for poll()
+    bool busy() const { return m_thread.joinable(); }
+
+    /// @brief Get the progress of the running work
+    /// @return Progress between 0 and 1
+    float progress() const { return m_progress; }
+
+    /// @brief Get the description of the running work
+    const std::string& label() const { return m_label; }
+
+private:
+    std::thread m_thread;
+    std::string m_label;
+    done_fn m_done;
+    std::atomic<float> m_progress{0.0f};
+    std::atomic<bool> m_finished{false};
+};
+
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "batch.hpp"
+#include "result_cache.hpp"
+#include "synthesis_pool.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Threads of a pool serving one call, 0 for one per hardware thread
+    int pool_threads(int threads, size_t count)
+    {
+        if (threads <= 0)
+            threads = (int)std::max(1u, std::thread::hardware_concurrency());
+        return (int)std::max<size_t>(1, std::min<size_t>((size_t)threads, count));
+    }
+}
+
+void gs::parallel_for(size_t count, const std::function<void(size_t)>& fn, int threads)
+{
+    // The only owner of its pool, so the background budget covers all threads
+    const int n = pool_threads(threads, count);
+    synthesis_pool pool(n, n);
+    for (size_t i = 0; i < count; ++i)
+        pool.submit(&pool, [&fn, i](const std::atomic<bool>&) {
+            fn(i);
+            return true;
+        });
+    pool.wait(&pool);
+}
+
+void gs::synthesize_batch(const grid_synth& synth,
+                          const std::vector<uint32_t>& seeds,
+                          const batch_sink& sink,
+                          int threads,
+                          result_cache* cache,
+                          const std::atomic<bool>* cancel)
+{
+    const int n = pool_threads(threads, seeds.size());
+    synthesis_pool pool(n, n);
+    for (uint32_t seed : seeds) {
+        // Each seed runs on its own clone, which starts from the same grid
+        pool.submit(&pool, [&, seed](const std::atomic<bool>&) {
+            if (cancel && *cancel)
+                return true;
+
+            auto start = std::chrono::steady_clock::now();
+            grid_synth local = synth.clone();
+            local.set_seed(seed);
+
+            synthesis_control control;
+            control.cancel = cancel;
+            bool hit = false;
+            if (cache)
+                hit = synthesize_cached(local, *cache, control);
+            else
+                local.synthesize(control);
+            if (cancel && *cancel)
+                return true;
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            sink({seed, local.get_grid(), elapsed.count(), hit});
+            return true;
+        });
+    }
+    pool.wait(&pool);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+class result_cache;
+
+////////////////////////////////////////////////////////////////////////////////
+////                            batch synthesis
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Run a function for every index in [0, count) on a pool of threads
+///
+/// Every index is a task of a synthesis_pool made for the call, so uneven
+/// work balances itself.
+/// @param count Number of indices
+/// @param fn Function called with each index, concurrently from the workers
+/// @param threads Number of worker threads, 0 for one per hardware thread
+void parallel_for(size_t count, const std::function<void(size_t)>& fn, int threads = 0);
+
+/// @brief Result of synthesizing one seed of a batch
+struct batch_result
+{
+    uint32_t seed;          ///< Seed the pipeline ran with
+    grid output;            ///< Synthesized grid
+    double seconds;         ///< Wall-clock time spent on this seed
+    bool cache_hit;         ///< Whether the result came from the result cache
+};
+
+/// @brief Callback receiving batch results
+/// @note Called concurrently from the worker threads, in no particular order
+using batch_sink = std::function<void(const batch_result&)>;
+
+/// @brief Synthesize a pipeline for many seeds on a pool of worker threads
+///
+/// Every seed is a task of a synthesis_pool made for the call and runs on its
+/// own clone of the synthesizer, starting from the synthesizer's current
+/// grid. Results are handed to the sink as soon as they are done.
+/// @param synth The synthesizer to run, left unchanged
+/// @param seeds The seeds to run
+/// @param sink Callback receiving each result
+/// @param threads Number of worker threads, 0 for one per hardware thread
+/// @param cache Optional result cache to consult before running
+/// @param cancel Optional flag that stops the batch when set
+void synthesize_batch(const grid_synth& synth,
+                      const std::vector<uint32_t>& seeds,
+                      const batch_sink& sink,
+                      int threads = 0,
+                      result_cache* cache = nullptr,
+                      const std::atomic<bool>* cancel = nullptr);
+
+}
@@ -0,0 +1,588 @@
+#include <algorithm>
+#include <stdexcept>
+#include "deflate.hpp"
+
+using namespace gs;
+
+namespace
+{
+    const uint16_t length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    const uint8_t length_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    const uint16_t dist_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    const uint8_t dist_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    const size_t window_size = 32768;
+    const size_t max_match = 258;
+    const size_t min_match = 3;
+}
+
+namespace
+{
+    /// Reads a deflate bit stream, pulling input from a byte source on demand
+    class bit_reader
+    {
+    public:
+        explicit bit_reader(const byte_source& in) : m_in(in) {}
+
+        uint8_t byte()
+        {
+            if (m_pos == m_size) {
+                m_size = m_in(m_buffer, sizeof(m_buffer));
+                m_pos = 0;
+                if (m_size == 0)
+                    throw std::runtime_error("Unexpected end of compressed data");
+            }
+            return m_buffer[m_pos++];
+        }
+
+        uint32_t bits(int count)
+        {
+            while (m_count < count) {
+                m_bits |= (uint32_t)byte() << m_count;
+                m_count += 8;
+            }
+            uint32_t v = m_bits & ((1u << count) - 1);
+            m_bits >>= count;
+            m_count -= count;
+            return v;
+        }
+
+        /// Drop the remaining bits of the current byte
+        void align()
+        {
+            m_bits = 0;
+            m_count = 0;
+        }
+
+    private:
+        const byte_source& m_in;
+        uint8_t m_buffer[16384];
+        size_t m_pos = 0;
+        size_t m_size = 0;
+        uint32_t m_bits = 0;
+        int m_count = 0;
+    };
+
+    /// Canonical Huffman decoding table
+    struct huffman
+    {
+        uint16_t count[16];
+        uint16_t symbol[288];
+
+        void build(const uint8_t* lengths, int n)
+        {
+            std::fill(count, count + 16, 0);
+            for (int i = 0; i < n; ++i)
+                count[lengths[i]]++;
+            count[0] = 0;
+
+            uint16_t offsets[16];
+            offsets[1] = 0;
+            for (int len = 1; len < 15; ++len)
+                offsets[len + 1] = offsets[len] + count[len];
+            for (int i = 0; i < n; ++i)
+                if (lengths[i])
+                    symbol[offsets[lengths[i]]++] = (uint16_t)i;
+        }
+
+        int decode(bit_reader& in) const
+        {
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len < 16; ++len) {
+                code |= (int)in.bits(1);
+                int n = count[len];
+                if (code - n < first)
+                    return symbol[index + (code - first)];
+                index += n;
+                first += n;
+                first <<= 1;
+                code <<= 1;
+            }
+            throw std::runtime_error("Invalid Huffman code in compressed data");
+        }
+    };
+
+    /// Keeps the last 32K of output for back references and flushes it to the sink
+    class output_window
+    {
+    public:
+        explicit output_window(const byte_sink& out) : m_out(out), m_data(window_size) {}
+
+        void put(uint8_t b)
+        {
+            m_data[m_pos++ & (window_size - 1)] = b;
+            if (m_pos - m_flushed >= window_size / 2)
+                flush();
+        }
+
+        void copy(size_t distance, size_t length)
+        {
+            if (distance > m_pos || distance > window_size)
+                throw std::runtime_error("Invalid distance in compressed data");
+            for (size_t i = 0; i < length; ++i)
+                put(m_data[(m_pos - distance) & (window_size - 1)]);
+        }
+
+        void flush()
+        {
+            while (m_flushed < m_pos) {
+                size_t start = m_flushed & (window_size - 1);
+                size_t len = std::min(m_pos - m_flushed, window_size - start);
+                m_out(m_data.data() + start, len);
+                m_flushed += len;
+            }
+        }
+
+    private:
+        const byte_sink& m_out;
+        std::vector<uint8_t> m_data;
+        size_t m_pos = 0;
+        size_t m_flushed = 0;
+    };
+
+    void inflate_codes(bit_reader& in, output_window& out, const huffman& lit, const huffman& dist)
+    {
+        for (;;) {
+            int symbol = lit.decode(in);
+            if (symbol < 256) {
+                out.put((uint8_t)symbol);
+            }
+            else if (symbol == 256) {
+                return;
+            }
+            else {
+                symbol -= 257;
+                if (symbol >= 29)
+                    throw std::runtime_error("Invalid length code in compressed data");
+                size_t length = length_base[symbol] + in.bits(length_extra[symbol]);
+                int d = dist.decode(in);
+                if (d >= 30)
+                    throw std::runtime_error("Invalid distance code in compressed data");
+                size_t distance = dist_base[d] + in.bits(dist_extra[d]);
+                out.copy(distance, length);
+            }
+        }
+    }
+
+    void inflate_stream(bit_reader& in, output_window& out)
+    {
+        static const uint8_t code_length_order[19] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+        };
+
+        bool last;
+        do {
+            last = in.bits(1) != 0;
+            uint32_t type = in.bits(2);
+
+            if (type == 0) {
+                // Stored block
+                in.align();
+                // Sequenced reads, the operands of | are evaluated in any order
+                uint16_t len = in.byte();
+                len |= in.byte() << 8;
+                uint16_t nlen = in.byte();
+                nlen |= in.byte() << 8;
+                if (len != (uint16_t)~nlen)
+                    throw std::runtime_error("Invalid stored block in compressed data");
+                for (uint16_t i = 0; i < len; ++i)
+                    out.put(in.byte());
+            }
+            else if (type == 1) {
+                // Fixed Huffman codes
+                static const auto tables = [] {
+                    uint8_t lengths[288];
+                    std::fill(lengths, lengths + 144, 8);
+                    std::fill(lengths + 144, lengths + 256, 9);
+                    std::fill(lengths + 256, lengths + 280, 7);
+                    std::fill(lengths + 280, lengths + 288, 8);
+                    std::pair<huffman, huffman> t;
+                    t.first.build(lengths, 288);
+                    std::fill(lengths, lengths + 30, 5);
+                    t.second.build(lengths, 30);
+                    return t;
+                }();
+                inflate_codes(in, out, tables.first, tables.second);
+            }
+            else if (type == 2) {
+                // Dynamic Huffman codes
+                int nlen = (int)in.bits(5) + 257;
+                int ndist = (int)in.bits(5) + 1;
+                int ncode = (int)in.bits(4) + 4;
+                if (nlen > 286 || ndist > 30)
+                    throw std::runtime_error("Invalid code counts in compressed data");
+
+                uint8_t lengths[320] = {};
+                for (int i = 0; i < ncode; ++i)
+                    lengths[code_length_order[i]] = (uint8_t)in.bits(3);
+                huffman code_lengths;
+                code_lengths.build(lengths, 19);
+
+                int index = 0;
+                std::fill(lengths, lengths + 320, 0);
+                while (index < nlen + ndist) {
+                    int symbol = code_lengths.decode(in);
+                    if (symbol < 16) {
+                        lengths[index++] = (uint8_t)symbol;
+                        continue;
+                    }
+
+                    uint8_t value = 0;
+                    int repeat;
+                    if (symbol == 16) {
+                        if (index == 0)
+                            throw std::runtime_error("Invalid repeat in compressed data");
+                        value = lengths[index - 1];
+                        repeat = 3 + (int)in.bits(2);
+                    }
+                    else if (symbol == 17) {
+                        repeat = 3 + (int)in.bits(3);
+                    }
+                    else {
+                        repeat = 11 + (int)in.bits(7);
+                    }
+                    if (index + repeat > nlen + ndist)
+                        throw std::runtime_error("Too many code lengths in compressed data");
+                    std::fill(lengths + index, lengths + index + repeat, value);
+                    index += repeat;
+                }
+
+                huffman lit, dist;
+                lit.build(lengths, nlen);
+                dist.build(lengths + nlen, ndist);
+                inflate_codes(in, out, lit, dist);
+            }
+            else {
+                throw std::runtime_error("Invalid block type in compressed data");
+            }
+        } while (!last);
+
+        out.flush();
+    }
+}
+
+void gs::inflate(const byte_source& in, const byte_sink& out)
+{
+    bit_reader reader(in);
+    output_window window(out);
+    inflate_stream(reader, window);
+}
+
+void gs::zlib_decompress(const byte_source& in, const byte_sink& out)
+{
+    bit_reader reader(in);
+    uint8_t cmf = reader.byte();
+    uint8_t flg = reader.byte();
+    if ((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0)
+        throw std::runtime_error("Invalid zlib header");
+    if (flg & 0x20)
+        throw std::runtime_error("zlib preset dictionaries are not supported");
+
+    uint32_t adler = 1;
+    byte_sink checked = [&](const uint8_t* data, size_t size) {
+        adler = adler32(data, size, adler);
+        out(data, size);
+    };
+    output_window window(checked);
+    inflate_stream(reader, window);
+
+    reader.align();
+    uint32_t expected = 0;
+    for (int i = 0; i < 4; ++i)
+        expected = (expected << 8) | reader.byte();
+    if (expected != adler)
+        throw std::runtime_error("zlib checksum mismatch");
+}
+
+std::vector<uint8_t> gs::zlib_decompress(const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> result;
+    size_t pos = 0;
+    zlib_decompress(
+        [&](uint8_t* buffer, size_t capacity) {
+            size_t n = std::min(capacity, size - pos);
+            std::copy(data + pos, data + pos + n, buffer);
+            pos += n;
+            return n;
+        },
+        [&](const uint8_t* bytes, size_t n) {
+            result.insert(result.end(), bytes, bytes + n);
+        });
+    return result;
+}
+
+uint32_t gs::crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t gs::adler32(const uint8_t* data, size_t size, uint32_t adler)
+{
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        // Largest block that can't overflow before taking the modulo
+        size_t block = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                                deflater
+////////////////////////////////////////////////////////////////////////////////
+
+deflater::deflater(byte_sink out, deflate_mode mode, bool zlib, size_t match_hint)
+    : m_sink(std::move(out)), m_mode(mode), m_zlib(zlib), m_match_hint(match_hint),
+      m_head((size_t)1 << hash_bits, -1)
+{
+    if (m_zlib) {
+        // CMF: deflate with a 32K window, FLG: no dictionary, check bits
+        m_out.push_back(0x78);
+        m_out.push_back(0x01);
+    }
+}
+
+deflater::~deflater()
+{
+    try {
+        finish();
+    }
+    catch (...) {
+        // The sink failed, nothing sensible left to do
+    }
+}
+
+void deflater::write(const uint8_t* data, size_t size)
+{
+    if (m_finished)
+        return;
+    if (m_zlib)
+        m_adler = adler32(data, size, m_adler);
+    m_buffer.insert(m_buffer.end(), data, data + size);
+    if (m_buffer.size() - m_pending >= block_size)
+        emit_block(false);
+}
+
+void deflater::finish()
+{
+    if (m_finished)
+        return;
+    m_finished = true;
+
+    emit_block(true);
+    align();
+    if (m_zlib) {
+        m_out.push_back((uint8_t)(m_adler >> 24));
+        m_out.push_back((uint8_t)(m_adler >> 16));
+        m_out.push_back((uint8_t)(m_adler >> 8));
+        m_out.push_back((uint8_t)m_adler);
+    }
+    flush();
+}
+
+void deflater::put_bits(uint32_t value, int count)
+{
+    m_bits |= (uint64_t)value << m_count;
+    m_count += count;
+    while (m_count >= 8) {
+        m_out.push_back((uint8_t)m_bits);
+        m_bits >>= 8;
+        m_count -= 8;
+    }
+}
+
+void deflater::put_code(uint32_t code, int length)
+{
+    // Huffman codes are defined most significant bit first
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+        reversed |= ((code >> i) & 1u) << (length - 1 - i);
+    put_bits(reversed, length);
+}
+
+void deflater::put_literal(int symbol)
+{
+    if (symbol < 144)
+        put_code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        put_code(0x190 + (symbol - 144), 9);
+    else if (symbol < 280)
+        put_code(symbol - 256, 7);
+    else
+        put_code(0xc0 + (symbol - 280), 8);
+}
+
+void deflater::put_match(size_t length, size_t distance)
+{
+    int l = 28;
+    while (length_base[l] > length)
+        l--;
+    put_literal(257 + l);
+    put_bits((uint32_t)(length - length_base[l]), length_extra[l]);
+
+    int d = 29;
+    while (dist_base[d] > distance)
+        d--;
+    put_code(d, 5);
+    put_bits((uint32_t)(distance - dist_base[d]), dist_extra[d]);
+}
+
+void deflater::align()
+{
+    if (m_count > 0)
+        put_bits(0, 8 - m_count);
+}
+
+void deflater::flush()
+{
+    if (!m_out.empty()) {
+        m_sink(m_out.data(), m_out.size());
+        m_out.clear();
+    }
+}
+
+void deflater::emit_block(bool final)
+{
+    const uint8_t* data = m_buffer.data();
+    const size_t end = m_buffer.size();
+
+    if (m_mode == deflate_mode::store) {
+        size_t pos = m_pending;
+        do {
+            size_t len = std::min<size_t>(65535, end - pos);
+            bool last = final && pos + len == end;
+            put_bits(last ? 1 : 0, 1);
+            put_bits(0, 2);     // BTYPE = 00, stored
+            align();
+            put_bits((uint32_t)len, 16);
+            put_bits((uint32_t)(~len & 0xffff), 16);
+            m_out.insert(m_out.end(), data + pos, data + pos + len);
+            pos += len;
+        } while (pos < end);
+    }
+    else {
+        put_bits(final ? 1 : 0, 1);
+        put_bits(1, 2);     // BTYPE = 01, fixed Huffman
+
+        auto hash = [&](size_t i) {
+            uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+            return (v * 2654435761u) >> (32 - hash_bits);
+        };
+
+        auto match_length = [&](size_t i, size_t candidate) {
+            size_t limit = std::min(max_match, end - i);
+            size_t n = 0;
+            while (n < limit && data[candidate + n] == data[i + n])
+                n++;
+            return n;
+        };
+
+        size_t i = m_pending;
+        while (i < end) {
+            size_t best_len = 0;
+            size_t best_dist = 0;
+
+            if (i + min_match <= end) {
+                auto consider = [&](size_t distance) {
+                    if (distance == 0 || distance > i || distance > window_size)
+                        return;
+                    size_t len = match_length(i, i - distance);
+                    if (len > best_len) {
+                        best_len = len;
+                        best_dist = distance;
+                    }
+                };
+
+                // Runs, the row above (if hinted) and the last position with the same prefix
+                consider(1);
+                if (m_match_hint)
+                    consider(m_match_hint);
+                uint32_t h = hash(i);
+                int64_t last = m_head[h] - (int64_t)m_base;
+                if (last >= 0)
+                    consider(i - (size_t)last);
+                m_head[h] = (int64_t)(m_base + i);
+            }
+
+            if (best_len >= min_match) {
+                put_match(best_len, best_dist);
+                for (size_t k = 1; k < best_len && i + k + min_match <= end; ++k)
+                    m_head[hash(i + k)] = (int64_t)(m_base + i + k);
+                i += best_len;
+            }
+            else {
+                put_literal(data[i]);
+                i++;
+            }
+        }
+
+        put_literal(256);    // End of block
+    }
+
+    // Keep only the window needed for back references in the next block
+    if (end > window_size) {
+        size_t drop = end - window_size;
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + drop);
+        m_base += drop;
+    }
+    m_pending = m_buffer.size();
+    flush();
+}
+
+std::vector<uint8_t> gs::deflate(const uint8_t* data, size_t size, deflate_mode mode, size_t match_hint)
+{
+    std::vector<uint8_t> out;
+    {
+        deflater d([&](const uint8_t* bytes, size_t n) { out.insert(out.end(), bytes, bytes + n); },
+                   mode, false, match_hint);
+        d.write(data, size);
+        d.finish();
+    }
+    return out;
+}
+
+std::vector<uint8_t> gs::zlib_compress(const uint8_t* data, size_t size, deflate_mode mode, size_t match_hint)
+{
+    std::vector<uint8_t> out;
+    {
+        deflater d([&](const uint8_t* bytes, size_t n) { out.insert(out.end(), bytes, bytes + n); },
+                   mode, true, match_hint);
+        d.write(data, size);
+        d.finish();
+    }
+    return out;
+}
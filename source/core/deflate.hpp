@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                                deflate
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Minimal in-tree deflate (RFC 1951) and zlib (RFC 1950) support
+///
+/// Just enough to read and write PNG and compressed TMX layers without
+/// pulling in a compression library. The encoder either stores the data
+/// uncompressed or emits fixed Huffman blocks with a greedy LZ77 matcher,
+/// which does well on the long runs and repeated rows found in grid images.
+/// The decoder handles all block types and streams: it only keeps the 32K
+/// window in memory, pulling input and pushing output through callbacks.
+
+/// @brief Deflate encoding modes
+enum class deflate_mode
+{
+    store,      ///< Uncompressed stored blocks, fastest
+    fixed       ///< Fixed Huffman blocks with LZ77 matching
+};
+
+/// @brief Callback supplying input bytes
+/// @param buffer Where to put the bytes
+/// @param capacity Maximum number of bytes to supply
+/// @return Number of bytes supplied, 0 at the end of the input
+using byte_source = std::function<size_t(uint8_t* buffer, size_t capacity)>;
+
+/// @brief Callback receiving output bytes
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+using byte_sink = std::function<void(const uint8_t* data, size_t size)>;
+
+/// @brief Compute a CRC-32 checksum (as used by PNG and gzip)
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+/// @param crc Running checksum to continue from
+/// @return The updated checksum
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/// @brief Compute an Adler-32 checksum (as used by zlib)
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+/// @param adler Running checksum to continue from
+/// @return The updated checksum
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+/// @brief Compress to a raw deflate stream
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+/// @param mode The encoding mode
+/// @param match_hint Extra match distance to try at every position, such as
+///        the row stride of an image, or 0 for none
+/// @return The deflate stream
+std::vector<uint8_t> deflate(const uint8_t* data, size_t size,
+                             deflate_mode mode = deflate_mode::fixed,
+                             size_t match_hint = 0);
+
+/// @brief Compress to a zlib stream (header, deflate stream and checksum)
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+/// @param mode The encoding mode
+/// @param match_hint Extra match distance to try, see deflate()
+/// @return The zlib stream
+std::vector<uint8_t> zlib_compress(const uint8_t* data, size_t size,
+                                   deflate_mode mode = deflate_mode::fixed,
+                                   size_t match_hint = 0);
+
+////////////////////////////////////////////////////////////////////////////////
+////                                deflater
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Streaming deflate encoder
+///
+/// Input is buffered until a block is full and then encoded, keeping only the
+/// last 32K as history for back references. Output is pushed to the sink as
+/// blocks complete, so arbitrarily large data can be compressed in a fixed
+/// amount of memory.
+class deflater
+{
+public:
+    /// @brief Constructor
+    /// @param out Sink receiving the compressed bytes
+    /// @param mode The encoding mode
+    /// @param zlib Wrap the stream in a zlib header and checksum
+    /// @param match_hint Extra match distance to try, see deflate()
+    explicit deflater(byte_sink out, deflate_mode mode = deflate_mode::fixed,
+                      bool zlib = true, size_t match_hint = 0);
+
+    /// @brief Destructor, finishes the stream if needed
+    ~deflater();
+
+    deflater(const deflater&) = delete;
+    deflater& operator=(const deflater&) = delete;
+
+    /// @brief Compress more input
+    /// @param data Pointer to the bytes
+    /// @param size Number of bytes
+    void write(const uint8_t* data, size_t size);
+
+    /// @brief Compress the remaining input and end the stream
+    void finish();
+
+private:
+    static const size_t block_size = 65536;
+    static const int hash_bits = 15;
+
+    void put_bits(uint32_t value, int count);
+    void put_code(uint32_t code, int length);
+    void put_literal(int symbol);
+    void put_match(size_t length, size_t distance);
+    void align();
+    void flush();
+    void emit_block(bool final);
+
+    byte_sink m_sink;
+    deflate_mode m_mode;
+    bool m_zlib;
+    size_t m_match_hint;
+    bool m_finished = false;
+    uint32_t m_adler = 1;
+
+    std::vector<uint8_t> m_out;         ///< Encoded bytes not yet handed to the sink
+    uint64_t m_bits = 0;                ///< Bits not yet forming a whole byte
+    int m_count = 0;                    ///< Number of those bits
+
+    std::vector<uint8_t> m_buffer;      ///< History window followed by pending input
+    size_t m_pending = 0;               ///< Index in m_buffer where pending input starts
+    uint64_t m_base = 0;                ///< Stream position of m_buffer[0]
+    std::vector<int64_t> m_head;        ///< Last stream position of each 3-byte hash
+};
+
+/// @brief Decompress a raw deflate stream incrementally
+/// @param in Source of compressed bytes
+/// @param out Sink receiving decompressed bytes in order
+/// @throws std::runtime_error if the stream is invalid or truncated
+void inflate(const byte_source& in, const byte_sink& out);
+
+/// @brief Decompress a zlib stream incrementally, verifying its checksum
+/// @param in Source of compressed bytes
+/// @param out Sink receiving decompressed bytes in order
+/// @throws std::runtime_error if the stream is invalid or truncated
+void zlib_decompress(const byte_source& in, const byte_sink& out);
+
+/// @brief Decompress a zlib stream held in memory
+/// @param data Pointer to the compressed bytes
+/// @param size Number of compressed bytes
+/// @return The decompressed bytes
+/// @throws std::runtime_error if the stream is invalid or truncated
+std::vector<uint8_t> zlib_decompress(const uint8_t* data, size_t size);
+
+}
@@ -0,0 +1,151 @@
+#include "file_watcher.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace gs;
+
+namespace
+{
+    // Quiet time that ends a burst of changes, in milliseconds
+    const int settle_ms = 50;
+
+#ifndef __linux__
+    // Interval of the modification time checks without inotify
+    const int poll_interval_ms = 250;
+
+    int64_t modification_time(const std::string& filename)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(filename, ec);
+        return ec ? 0 : (int64_t)time.time_since_epoch().count();
+    }
+#endif
+}
+
+file_watcher::~file_watcher()
+{
+    stop();
+}
+
+bool file_watcher::watch(const std::string& filename)
+{
+    stop();
+
+    std::filesystem::path path(filename);
+    std::string directory = path.parent_path().string();
+    if (directory.empty())
+        directory = ".";
+
+#ifdef __linux__
+    // Watch the directory, the file itself may be replaced by a new inode
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "Could not start watching files" << std::endl;
+        return false;
+    }
+    m_wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (m_wd < 0) {
+        std::cerr << "Could not watch directory: " << directory << std::endl;
+        stop();
+        return false;
+    }
+#else
+    if (!std::filesystem::is_directory(directory)) {
+        std::cerr << "Could not watch directory: " << directory << std::endl;
+        return false;
+    }
+    m_mtime = modification_time(filename);
+#endif
+
+    m_filename = filename;
+    m_name = path.filename().string();
+    return true;
+}
+
+void file_watcher::stop()
+{
+#ifdef __linux__
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+    m_fd = -1;
+    m_wd = -1;
+    m_filename.clear();
+    m_name.clear();
+}
+
+bool file_watcher::changed()
+{
+    if (!watching())
+        return false;
+
+#ifdef __linux__
+    // Drain all queued events, other files of the directory are ignored
+    bool hit = false;
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t size = read(m_fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        for (char* p = buffer; p < buffer + size;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->len > 0 && m_name == event->name)
+                hit = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return hit;
+#else
+    int64_t mtime = modification_time(m_filename);
+    if (mtime == m_mtime)
+        return false;
+    m_mtime = mtime;
+    return mtime != 0;
+#endif
+}
+
+bool file_watcher::wait(int timeout_ms)
+{
+    if (!watching())
+        return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    auto remaining = [&]() {
+        if (timeout_ms < 0)
+            return -1;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        return (int)std::max<int64_t>(0, left.count());
+    };
+
+#ifdef __linux__
+    pollfd fd{m_fd, POLLIN, 0};
+    while (!changed()) {
+        int timeout = remaining();
+        if (timeout == 0 || poll(&fd, 1, timeout) <= 0)
+            return false;
+    }
+    // Let a burst of writes finish before reporting
+    while (poll(&fd, 1, settle_ms) > 0)
+        changed();
+    return true;
+#else
+    while (!changed()) {
+        int timeout = remaining();
+        if (timeout == 0)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout < 0 ? poll_interval_ms : std::min(timeout, poll_interval_ms)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(settle_ms));
+    changed();
+    return true;
+#endif
+}
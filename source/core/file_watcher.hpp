@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            file_watcher
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reports changes to one file on disk
+///
+/// On Linux the directory of the file is watched with inotify, so no time is
+/// spent while nothing happens, and files replaced by a rename, as done by
+/// most editors and by version control, are noticed as well as files written
+/// in place. Elsewhere the modification time is compared on every check.
+class file_watcher
+{
+public:
+    /// @brief Constructor
+    file_watcher() = default;
+
+    /// @brief Destructor, stops watching
+    ~file_watcher();
+
+    file_watcher(const file_watcher&) = delete;
+    file_watcher& operator=(const file_watcher&) = delete;
+
+    /// @brief Start watching a file, replacing the watched one
+    /// @param filename Path to the file, it does not need to exist yet
+    /// @return True on success, false if the directory can't be watched
+    bool watch(const std::string& filename);
+
+    /// @brief Stop watching
+    void stop();
+
+    /// @brief Check if a file is watched
+    bool watching() const { return !m_filename.empty(); }
+
+    /// @brief Get the watched file
+    const std::string& filename() const { return m_filename; }
+
+    /// @brief Check if the file changed since the last call, without blocking
+    /// @return True if it was written, created or replaced
+    bool changed();
+
+    /// @brief Wait until the file changes
+    ///
+    /// Changes arriving in quick succession, such as a file written in
+    /// several parts, are reported once.
+    /// @param timeout_ms Longest time to wait, negative to wait forever
+    /// @return True if the file changed, false on timeout or when not watching
+    bool wait(int timeout_ms = -1);
+
+private:
+    std::string m_filename;
+    std::string m_name;         ///< File name without its directory
+    int m_fd = -1;              ///< inotify instance
+    int m_wd = -1;              ///< Watch on the directory of the file
+    int64_t m_mtime = 0;        ///< Last modification time, without inotify
+};
+
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include "grid_diff.hpp"
+#include "grid_io.hpp"
+
+using namespace gs;
+
+namespace
+{
+    void put_value(std::vector<uint8_t>& out, int value)
+    {
+        // Zigzag so the negative wildcard stays a single byte
+        uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    int get_value(const uint8_t*& in)
+    {
+        uint32_t v = 0;
+        int shift = 0;
+        while (*in & 0x80) {
+            v |= (uint32_t)(*in++ & 0x7f) << shift;
+            shift += 7;
+        }
+        v |= (uint32_t)*in++ << shift;
+        return (int)(v >> 1) ^ -(int)(v & 1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            grid_diff
+////////////////////////////////////////////////////////////////////////////////
+
+void grid_diff::add_cell(uint32_t index, int before, int after)
+{
+    if (!m_runs.empty() && m_runs[m_runs.size() - 2] + m_runs.back() == index) {
+        m_runs.back()++;
+    } else {
+        m_runs.push_back(index);
+        m_runs.push_back(1);
+    }
+    put_value(m_before, before);
+    put_value(m_after, after);
+}
+
+grid_diff grid_diff::between(const grid& before, const grid& after)
+{
+    grid_diff diff;
+    if (before.width() != after.width() || before.height() != after.height()) {
+        diff.m_full_before = compress_grid(before);
+        diff.m_full_after = compress_grid(after);
+        return diff;
+    }
+
+    const int* b = before.raw_data();
+    const int* a = after.raw_data();
+    const size_t count = (size_t)after.width() * after.height();
+    for (size_t i = 0; i < count; ++i) {
+        if (b[i] != a[i])
+            diff.add_cell((uint32_t)i, b[i], a[i]);
+    }
+    diff.shrink();
+    return diff;
+}
+
+grid_diff grid_diff::from_cells(const grid& after, std::vector<std::pair<uint32_t, int>> old_cells)
+{
+    // The first recorded value of a cell is its value before the change
+    std::stable_sort(old_cells.begin(), old_cells.end(),
+                     [](const auto& l, const auto& r) { return l.first < r.first; });
+
+    grid_diff diff;
+    const int* a = after.raw_data();
+    const size_t count = (size_t)after.width() * after.height();
+    for (size_t i = 0; i < old_cells.size(); ++i) {
+        const auto& [index, before] = old_cells[i];
+        if (i > 0 && old_cells[i - 1].first == index)
+            continue;
+        if (index < count && a[index] != before)
+            diff.add_cell(index, before, a[index]);
+    }
+    diff.shrink();
+    return diff;
+}
+
+void grid_diff::shrink()
+{
+    m_runs.shrink_to_fit();
+    m_before.shrink_to_fit();
+    m_after.shrink_to_fit();
+}
+
+void grid_diff::apply(grid& g, bool forward) const
+{
+    if (!m_full_before.empty()) {
+        const auto& full = forward ? m_full_after : m_full_before;
+        g = decompress_grid(full.data(), full.size());
+        return;
+    }
+
+    const uint8_t* values = forward ? m_after.data() : m_before.data();
+    int* cells = g.raw_data();
+    for (size_t r = 0; r < m_runs.size(); r += 2) {
+        const uint32_t first = m_runs[r];
+        const uint32_t end = first + m_runs[r + 1];
+        for (uint32_t i = first; i < end; ++i)
+            cells[i] = get_value(values);
+    }
+}
+
+size_t grid_diff::bytes() const
+{
+    return sizeof(grid_diff) +
+           m_runs.capacity() * sizeof(uint32_t) +
+           m_before.capacity() + m_after.capacity() +
+           m_full_before.capacity() + m_full_after.capacity();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            grid_diff
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compact record of a change to a grid
+///
+/// Changed cells are stored as runs of consecutive cell indices, with the old
+/// and new values varint encoded, so a brush stroke costs a few bytes per
+/// touched cell. When the size of the grid changed, both grids are stored
+/// run-length compressed instead.
+class grid_diff
+{
+public:
+    /// @brief Record the difference between two grids
+    /// @param before The grid before the change
+    /// @param after The grid after the change
+    /// @return The diff
+    static grid_diff between(const grid& before, const grid& after);
+
+    /// @brief Record a change to individual cells
+    /// @param after The grid after the change
+    /// @param old_cells Index and previous value of every changed cell
+    /// @return The diff
+    static grid_diff from_cells(const grid& after, std::vector<std::pair<uint32_t, int>> old_cells);
+
+    /// @brief Apply the change or revert it
+    /// @param g The grid to change
+    /// @param forward True to redo the change, false to undo it
+    void apply(grid& g, bool forward) const;
+
+    /// @brief Check if nothing changed
+    /// @return True if applying the diff has no effect
+    bool empty() const { return m_runs.empty() && m_full_before.empty(); }
+
+    /// @brief Get the memory used by the diff
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    void add_cell(uint32_t index, int before, int after);
+    void shrink();
+
+    std::vector<uint32_t> m_runs;           ///< Pairs of first cell index and length
+    std::vector<uint8_t> m_before;          ///< Old values of the changed cells
+    std::vector<uint8_t> m_after;           ///< New values of the changed cells
+    std::vector<uint8_t> m_full_before;     ///< Whole grid before a resize
+    std::vector<uint8_t> m_full_after;      ///< Whole grid after a resize
+};
+
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "grid_io.hpp"
+
+using namespace gs;
+
+namespace
+{
+    const char grid_magic[4] = {'G', 'S', 'G', '1'};
+
+    bool host_is_little_endian()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+    }
+
+    void write_u32(std::ostream& out, uint32_t v)
+    {
+        unsigned char b[4] = {
+            (unsigned char)(v), (unsigned char)(v >> 8),
+            (unsigned char)(v >> 16), (unsigned char)(v >> 24)
+        };
+        out.write(reinterpret_cast<const char*>(b), 4);
+    }
+
+    uint32_t read_u32(std::istream& in)
+    {
+        unsigned char b[4];
+        in.read(reinterpret_cast<char*>(b), 4);
+        return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    }
+}
+
+void gs::write_grid_binary(std::ostream& out, const grid& g)
+{
+    out.write(grid_magic, 4);
+    write_u32(out, (uint32_t)g.width());
+    write_u32(out, (uint32_t)g.height());
+
+    const size_t count = (size_t)g.width() * g.height();
+    if (host_is_little_endian()) {
+        out.write(reinterpret_cast<const char*>(g.raw_data()), count * sizeof(int32_t));
+    } else {
+        for (size_t i = 0; i < count; ++i)
+            write_u32(out, (uint32_t)g.raw_data()[i]);
+    }
+
+    if (!out)
+        throw std::runtime_error("Failed to write binary grid");
+}
+
+grid gs::read_grid_binary(std::istream& in)
+{
+    char magic[4];
+    in.read(magic, 4);
+    if (!in || std::memcmp(magic, grid_magic, 4) != 0)
+        throw std::runtime_error("Not a binary grid");
+
+    int width = (int)read_u32(in);
+    int height = (int)read_u32(in);
+    if (!in || width < 0 || height < 0 || (uint64_t)width * height > INT32_MAX)
+        throw std::runtime_error("Invalid binary grid dimensions");
+
+    grid g(width, height);
+    const size_t count = (size_t)width * height;
+    if (host_is_little_endian()) {
+        in.read(reinterpret_cast<char*>(g.raw_data()), count * sizeof(int32_t));
+    } else {
+        for (size_t i = 0; i < count; ++i)
+            g.raw_data()[i] = (int)read_u32(in);
+    }
+
+    if (!in)
+        throw std::runtime_error("Truncated binary grid");
+    return g;
+}
+
+bool gs::save_grid_binary(const std::string& filename, const grid& g)
+{
+    try {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file for writing: " << filename << std::endl;
+            return false;
+        }
+        write_grid_binary(file, g);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error saving grid: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool gs::load_grid_binary(const std::string& filename, grid& g)
+{
+    try {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        g = read_grid_binary(file);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading grid: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+namespace
+{
+    const char rle_magic[4] = {'G', 'S', 'R', '1'};
+
+    void put_varint(std::vector<uint8_t>& out, uint64_t v)
+    {
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    uint64_t get_varint(const uint8_t*& p, const uint8_t* end)
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end)
+                throw std::runtime_error("Truncated compressed grid");
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        throw std::runtime_error("Invalid varint in compressed grid");
+    }
+
+    uint64_t zigzag(int v) { return ((uint64_t)(uint32_t)v << 1) ^ (uint64_t)(int64_t)(v >> 31); }
+    int unzigzag(uint64_t v) { return (int)((uint32_t)(v >> 1) ^ (uint32_t)-(int64_t)(v & 1)); }
+}
+
+std::vector<uint8_t> gs::compress_grid(const grid& g)
+{
+    std::vector<uint8_t> out(rle_magic, rle_magic + 4);
+    put_varint(out, (uint64_t)g.width());
+    put_varint(out, (uint64_t)g.height());
+
+    const int* cells = g.raw_data();
+    const size_t count = (size_t)g.width() * g.height();
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && cells[i + run] == cells[i])
+            run++;
+        put_varint(out, run);
+        put_varint(out, zigzag(cells[i]));
+        i += run;
+    }
+    return out;
+}
+
+grid gs::decompress_grid(const uint8_t* data, size_t size)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    if (size < 4 || std::memcmp(p, rle_magic, 4) != 0)
+        throw std::runtime_error("Not a compressed grid");
+    p += 4;
+
+    uint64_t width = get_varint(p, end);
+    uint64_t height = get_varint(p, end);
+    if (width > INT32_MAX || height > INT32_MAX || width * height > INT32_MAX)
+        throw std::runtime_error("Invalid compressed grid dimensions");
+
+    grid g((int)width, (int)height);
+    int* cells = g.raw_data();
+    const size_t count = (size_t)width * height;
+    size_t i = 0;
+    while (i < count) {
+        uint64_t run = get_varint(p, end);
+        int value = unzigzag(get_varint(p, end));
+        if (run == 0 || run > count - i)
+            throw std::runtime_error("Invalid run in compressed grid");
+        std::fill(cells + i, cells + i + run, value);
+        i += run;
+    }
+    return g;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            binary grid format
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compact binary serialization of a grid
+///
+/// The layout is a four byte magic ("GSG1"), the width and height as 32-bit
+/// integers and then the cell values row by row as 32-bit integers, all in
+/// little-endian byte order. Reading it back is a single bulk copy, unlike the
+/// JSON format which goes through a DOM.
+
+/// @brief Write a grid in the binary grid format
+/// @param out The stream to write to
+/// @param g The grid to write
+/// @throws std::runtime_error if writing fails
+void write_grid_binary(std::ostream& out, const grid& g);
+
+/// @brief Read a grid in the binary grid format
+/// @param in The stream to read from
+/// @return The grid
+/// @throws std::runtime_error if the data is not a valid binary grid
+grid read_grid_binary(std::istream& in);
+
+/// @brief Save a grid to a file in the binary grid format
+/// @param filename Path to the file
+/// @param g The grid to save
+/// @return True if save was successful, false otherwise
+bool save_grid_binary(const std::string& filename, const grid& g);
+
+/// @brief Load a grid from a file in the binary grid format
+/// @param filename Path to the file
+/// @param g The grid to load into
+/// @return True if load was successful, false otherwise
+bool load_grid_binary(const std::string& filename, grid& g);
+
+////////////////////////////////////////////////////////////////////////////////
+////                          compressed grid format
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Run-length compressed serialization of a grid
+///
+/// The layout is a four byte magic ("GSR1"), the width and height as varints
+/// and then the cells row by row as runs: a varint run length followed by the
+/// zigzag varint encoded value. Synthesized maps are dominated by long runs of
+/// the same symbol, so this is usually an order of magnitude smaller than the
+/// binary grid format while being much cheaper than a general purpose codec.
+
+/// @brief Compress a grid
+/// @param g The grid to compress
+/// @return The compressed bytes
+std::vector<uint8_t> compress_grid(const grid& g);
+
+/// @brief Decompress a grid
+/// @param data Pointer to the compressed bytes
+/// @param size Number of compressed bytes
+/// @return The grid
+/// @throws std::runtime_error if the data is not a valid compressed grid
+grid decompress_grid(const uint8_t* data, size_t size);
+
+}
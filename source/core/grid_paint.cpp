@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstdlib>
+#include "grid_paint.hpp"
+
+using namespace gs;
+
+void paint_batch::set(grid& g, int x, int y, int value)
+{
+    if (!g.in_bounds(x, y) || g(x, y) == value)
+        return;
+
+    old_cells.emplace_back((uint32_t)(y * g.width() + x), g(x, y));
+    g(x, y) = value;
+
+    if (empty()) {
+        x0 = x1 = x;
+        y0 = y1 = y;
+    } else {
+        x0 = std::min(x0, x);
+        y0 = std::min(y0, y);
+        x1 = std::max(x1, x);
+        y1 = std::max(y1, y);
+    }
+}
+
+void gs::paint_disc(grid& g, int cx, int cy, int radius, int value, paint_batch& batch)
+{
+    // Cells whose centers are within the radius, rounded so small discs look round
+    const int r2 = radius * radius + radius;
+    const int ya = std::max(0, cy - radius);
+    const int yb = std::min(g.height() - 1, cy + radius);
+    for (int y = ya; y <= yb; ++y) {
+        const int dy = y - cy;
+        int dx = 0;
+        while ((dx + 1) * (dx + 1) + dy * dy <= r2)
+            dx++;
+        const int xa = std::max(0, cx - dx);
+        const int xb = std::min(g.width() - 1, cx + dx);
+        for (int x = xa; x <= xb; ++x)
+            batch.set(g, x, y, value);
+    }
+}
+
+void gs::paint_line(grid& g, int xa, int ya, int xb, int yb, int radius, int value, paint_batch& batch)
+{
+    // Bresenham, stamping the brush at every step
+    const int dx = std::abs(xb - xa);
+    const int dy = -std::abs(yb - ya);
+    const int sx = xa < xb ? 1 : -1;
+    const int sy = ya < yb ? 1 : -1;
+    int error = dx + dy;
+    for (;;) {
+        if (radius > 0)
+            paint_disc(g, xa, ya, radius, value, batch);
+        else
+            batch.set(g, xa, ya, value);
+        if (xa == xb && ya == yb)
+            break;
+        const int e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            xa += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            ya += sy;
+        }
+    }
+}
+
+void gs::flood_fill(grid& g, int x, int y, int value, paint_batch& batch)
+{
+    if (!g.in_bounds(x, y))
+        return;
+    const int target = g(x, y);
+    if (target == value)
+        return;
+
+    // Seeds are cells of the region, filled spans can't match the target anymore
+    std::vector<std::pair<int, int>> seeds{{x, y}};
+    while (!seeds.empty()) {
+        auto [sx, sy] = seeds.back();
+        seeds.pop_back();
+        if (g(sx, sy) != target)
+            continue;
+
+        int left = sx;
+        while (left > 0 && g(left - 1, sy) == target)
+            left--;
+        int right = sx;
+        while (right + 1 < g.width() && g(right + 1, sy) == target)
+            right++;
+        for (int i = left; i <= right; ++i)
+            batch.set(g, i, sy, value);
+
+        // One seed per run of target cells in the rows above and below
+        for (int ny : {sy - 1, sy + 1}) {
+            if (ny < 0 || ny >= g.height())
+                continue;
+            bool in_run = false;
+            for (int i = left; i <= right; ++i) {
+                const bool match = g(i, ny) == target;
+                if (match && !in_run)
+                    seeds.emplace_back(i, ny);
+                in_run = match;
+            }
+        }
+    }
+}
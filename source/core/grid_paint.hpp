@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            paint_batch
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Cells written by one or more painting operations
+///
+/// Collects the previous values for undo and the bounding box of the writes,
+/// so a whole frame of painting is reported to views as one changed region.
+struct paint_batch
+{
+    /// @brief Index and previous value of every written cell, in the format
+    /// of grid_diff::from_cells(), a cell may appear more than once
+    std::vector<std::pair<uint32_t, int>> old_cells;
+
+    int x0 = 0;                 ///< Bounding box of the writes, empty when x0 > x1
+    int y0 = 0;
+    int x1 = -1;
+    int y1 = -1;
+
+    /// @brief Check if no cell was changed
+    bool empty() const { return x0 > x1; }
+
+    /// @brief Write a cell, recording it if its value changes
+    /// @param g The grid
+    /// @param x Column, ignored if out of bounds
+    /// @param y Row, ignored if out of bounds
+    /// @param value The new value
+    void set(grid& g, int x, int y, int value);
+};
+
+/// @brief Paint a filled disc
+/// @param g The grid
+/// @param cx Column of the center, may be outside the grid
+/// @param cy Row of the center, may be outside the grid
+/// @param radius Radius in cells, 0 for a single cell
+/// @param value The value to paint
+/// @param batch Receives the changed cells
+void paint_disc(grid& g, int cx, int cy, int radius, int value, paint_batch& batch);
+
+/// @brief Paint a line with round ends
+///
+/// Used to connect the mouse positions of consecutive frames, so fast
+/// strokes leave no gaps.
+/// @param g The grid
+/// @param xa Column of the start
+/// @param ya Row of the start
+/// @param xb Column of the end
+/// @param yb Row of the end
+/// @param radius Radius of the brush in cells, 0 for a one cell wide line
+/// @param value The value to paint
+/// @param batch Receives the changed cells
+void paint_line(grid& g, int xa, int ya, int xb, int yb, int radius, int value, paint_batch& batch);
+
+/// @brief Replace the 4-connected region of equal cells around a cell
+///
+/// Scanline flood fill, each row span is filled in one pass and only the
+/// spans above and below it are queued.
+/// @param g The grid
+/// @param x Column of the start cell
+/// @param y Row of the start cell
+/// @param value The value to fill with
+/// @param batch Receives the changed cells
+void flood_fill(grid& g, int x, int y, int value, paint_batch& batch);
+
+}
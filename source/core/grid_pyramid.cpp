@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "grid_pyramid.hpp"
+
+using namespace gs;
+
+namespace
+{
+    /// Most common of four values, the first one wins ties
+    int majority(int a, int b, int c, int d)
+    {
+        if (a == b || a == c || a == d)
+            return a;
+        if (b == c || b == d)
+            return b;
+        if (c == d)
+            return c;
+        return a;
+    }
+}
+
+grid gs::make_thumbnail(const grid& g, int max_size)
+{
+    const int step = std::max(1, (std::max(g.width(), g.height()) + max_size - 1) / std::max(1, max_size));
+    grid thumbnail((g.width() + step - 1) / step, (g.height() + step - 1) / step);
+    for (int y = 0; y < thumbnail.height(); ++y)
+        for (int x = 0; x < thumbnail.width(); ++x)
+            thumbnail(x, y) = g(x * step, y * step);
+    return thumbnail;
+}
+
+void grid_pyramid::downsample(const grid& src, grid& dst, int x0, int y0, int x1, int y1)
+{
+    // Region in destination cells, clamped to the destination
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(dst.width() - 1, x1);
+    y1 = std::min(dst.height() - 1, y1);
+
+    const int* in = src.raw_data();
+    int* out = dst.raw_data();
+    const int sw = src.width();
+    for (int y = y0; y <= y1; ++y) {
+        const int sy0 = y * 2;
+        const int sy1 = std::min(sy0 + 1, src.height() - 1);
+        const int* row0 = in + (size_t)sy0 * sw;
+        const int* row1 = in + (size_t)sy1 * sw;
+        int* drow = out + (size_t)y * dst.width();
+        for (int x = x0; x <= x1; ++x) {
+            const int sx0 = x * 2;
+            const int sx1 = std::min(sx0 + 1, sw - 1);
+            drow[x] = majority(row0[sx0], row0[sx1], row1[sx0], row1[sx1]);
+        }
+    }
+}
+
+void grid_pyramid::build(const grid& g)
+{
+    m_width = g.width();
+    m_height = g.height();
+    m_levels.clear();
+
+    const grid* src = &g;
+    while (src->width() > 1 || src->height() > 1) {
+        grid level((src->width() + 1) / 2, (src->height() + 1) / 2, alphabet::empty_symbol.id);
+        downsample(*src, level, 0, 0, level.width() - 1, level.height() - 1);
+        m_levels.push_back(std::move(level));
+        src = &m_levels.back();
+    }
+}
+
+void grid_pyramid::update(const grid& g, int x0, int y0, int x1, int y1)
+{
+    if (g.width() != m_width || g.height() != m_height) {
+        build(g);
+        return;
+    }
+
+    const grid* src = &g;
+    for (auto& level : m_levels) {
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 >>= 1;
+        y1 >>= 1;
+        downsample(*src, level, x0, y0, x1, y1);
+        src = &level;
+    }
+}
+
+size_t grid_pyramid::bytes() const
+{
+    size_t total = 0;
+    for (const auto& level : m_levels)
+        total += (size_t)level.width() * level.height() * sizeof(int);
+    return total;
+}
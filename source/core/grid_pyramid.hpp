@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+/// @brief Downsample a grid for a thumbnail
+///
+/// Samples every n-th cell, which is much cheaper than building a pyramid
+/// and good enough for previews.
+/// @param g The grid
+/// @param max_size Largest side of the thumbnail in cells
+/// @return The thumbnail
+grid make_thumbnail(const grid& g, int max_size);
+
+////////////////////////////////////////////////////////////////////////////////
+////                            grid_pyramid
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Mip pyramid of a grid for drawing it at low zoom
+///
+/// Every level halves the resolution of the previous one, each cell holding
+/// the most common symbol of its 2x2 block (the top-left one on ties). Level 0
+/// is the source grid itself and is not stored. Edits can be propagated up
+/// the pyramid for just the changed region.
+class grid_pyramid
+{
+public:
+    /// @brief Constructor, creates an empty pyramid
+    grid_pyramid() = default;
+
+    /// @brief Rebuild all levels from a grid
+    /// @param g The source grid
+    void build(const grid& g);
+
+    /// @brief Update the levels after a region of the source grid changed
+    ///
+    /// Rebuilds everything if the grid size changed since the last build.
+    /// @param g The source grid
+    /// @param x0 Left column of the changed region
+    /// @param y0 Top row of the changed region
+    /// @param x1 Right column of the changed region, inclusive
+    /// @param y1 Bottom row of the changed region, inclusive
+    void update(const grid& g, int x0, int y0, int x1, int y1);
+
+    /// @brief Get the number of levels, including the source grid
+    /// @return The number of levels
+    int level_count() const { return (int)m_levels.size() + 1; }
+
+    /// @brief Get a downsampled level
+    /// @param level The level, from 1 to level_count() - 1
+    /// @return The grid of that level
+    const grid& level(int level) const { return m_levels[level - 1]; }
+
+    /// @brief Get the width of the source grid the pyramid was built from
+    int width() const { return m_width; }
+
+    /// @brief Get the height of the source grid the pyramid was built from
+    int height() const { return m_height; }
+
+    /// @brief Get the memory used by the downsampled levels
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    static void downsample(const grid& src, grid& dst, int x0, int y0, int x1, int y1);
+
+    std::vector<grid> m_levels;
+    int m_width = 0;
+    int m_height = 0;
+};
+
+}
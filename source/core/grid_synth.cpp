@@ -1,8 +1,15 @@
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include "grid_synth.hpp"
+#include "grid_pyramid.hpp"
+#include "hash.hpp"
+#include "pattern_matcher.hpp"
+#include "stage_cache.hpp"
+#include "synthesis_timeline.hpp"
 
 using namespace gs;
 
@@ -34,25 +41,42 @@ void grid::clear(int value)
 const symbol alphabet::empty_symbol = {0, "empty"};
 const symbol alphabet::wildcard_symbol = {-1, "wildcard"};
 
+namespace
+{
+    uint64_t next_alphabet_version()
+    {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+}
+
 alphabet::alphabet()
+    : m_version(next_alphabet_version())
 {
     // add_symbol(empty_symbol);
     // add_symbol(wildcard_symbol);
 }
 
-const std::vector<symbol>& alphabet::get_symbols() const
+void alphabet::update_symbol_list()
 {
-    static std::vector<symbol> symbols;
-    symbols.clear();
+    m_symbol_list.clear();
     for (const auto& [id, s] : m_symbols)
-        symbols.push_back(s);
-    return symbols;
+        m_symbol_list.push_back(s);
+    m_version = next_alphabet_version();
 }
 
 void alphabet::add_symbol(const symbol &s)
 {
-    if(m_symbols.find(s.id) == m_symbols.end())
+    if(m_symbols.find(s.id) == m_symbols.end()) {
         m_symbols[s.id] = s;
+        update_symbol_list();
+    }
+}
+
+void alphabet::remove_symbol(int id)
+{
+    if (m_symbols.erase(id))
+        update_symbol_list();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -60,8 +84,7 @@ void alphabet::add_symbol(const symbol &s)
 ////////////////////////////////////////////////////////////////////////////////
 void rule_based_transformation::apply(const grid& input, grid& output)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(m_seed);
     std::uniform_real_distribution<float> dis(0.0f, 1.0f);
 
     // Ensure output grid has the same dimensions as input
@@ -76,43 +99,90 @@ void rule_based_transformation::apply(const grid& input, grid& output)
         }
     }
 
+    m_statistics = {};
+
     // Then apply pattern matching and replacements
+    const pattern_matcher matcher(m_search);
     for(int i = 0; i < input.width(); ++i) {
         for (int j = 0; j < input.height(); ++j) {
-            if (!input.in_bounds(i + m_search.width() - 1, j + m_search.height() - 1))
-                continue;
-
-            bool match = true;
-            for (int x = 0; x < m_search.width(); ++x) {
-                for (int y = 0; y < m_search.height(); ++y) {
-                    if (m_search(x, y) == alphabet::wildcard_symbol.id)
-                        continue;
-                    if (input(i + x, j + y) != m_search(x, y)) {
-                        match = false;
-                        break;
-                    }
+            if (matcher.matches(input, i, j)) {
+                m_statistics.matches++;
+                if (const grid* replacement = pick_replacement(dis(gen))) {
+                    for (int x = 0; x < replacement->width(); ++x)
+                        for (int y = 0; y < replacement->height(); ++y) {
+                            if ((*replacement)(x, y) == alphabet::wildcard_symbol.id)
+                                continue;
+                            output(i + x, j + y) = (*replacement)(x, y);
+                            m_statistics.cells_written++;
+                        }
                 }
-                if (!match) break;
             }
+        }
+    }
+}
+
+size_t rule_based_transformation::apply_region(const grid& input, grid& output, int x0, int y0, int x1, int y1) const
+{
+    std::mt19937 gen(m_seed);
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(input.width() - 1, x1);
+    y1 = std::min(input.height() - 1, y1);
+    output.resize(std::max(0, x1 - x0 + 1), std::max(0, y1 - y0 + 1));
+    for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+            output(x - x0, y - y0) = input(x, y);
+
+    // Halo of positions left of and above the region whose patterns overlap it
+    int halo_x = m_search.width() - 1;
+    int halo_y = m_search.height() - 1;
+    for (const auto& entry : m_replacement) {
+        halo_x = std::max(halo_x, entry.replacement.width() - 1);
+        halo_y = std::max(halo_y, entry.replacement.height() - 1);
+    }
 
-            if (match) {
-                float r = dis(gen);
-                float acc = 0.0f;
-                for (const auto &[p, replacement]: m_replacement) {
-                    acc += p;
-                    if (r <= acc) {
-                        for (int x = 0; x < replacement.width(); ++x)
-                            for (int y = 0; y < replacement.height(); ++y) {
-                                if (replacement(x, y) == alphabet::wildcard_symbol.id)
-                                    continue;
-                                output(i + x, j + y) = replacement(x, y);
-                            }
-                        break;
+    size_t matches = 0;
+    const pattern_matcher matcher(m_search);
+    for (int i = std::max(0, x0 - halo_x); i <= x1; ++i) {
+        for (int j = std::max(0, y0 - halo_y); j <= y1; ++j) {
+            if (!matcher.matches(input, i, j))
+                continue;
+            matches++;
+            if (const grid* replacement = pick_replacement(dis(gen))) {
+                for (int x = 0; x < replacement->width(); ++x)
+                    for (int y = 0; y < replacement->height(); ++y) {
+                        const int ox = i + x - x0;
+                        const int oy = j + y - y0;
+                        if ((*replacement)(x, y) != alphabet::wildcard_symbol.id && output.in_bounds(ox, oy))
+                            output(ox, oy) = (*replacement)(x, y);
                     }
-                }
             }
         }
     }
+    return matches;
+}
+
+const grid* rule_based_transformation::pick_replacement(float r) const
+{
+    float acc = 0.0f;
+    for (const auto& entry : m_replacement) {
+        acc += entry.probability;
+        if (r <= acc)
+            return &entry.replacement;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<transformation> rule_based_transformation::clone(std::shared_ptr<alphabet> alphabet) const
+{
+    auto copy = std::make_unique<rule_based_transformation>(m_name, std::move(alphabet));
+    copy->m_enabled = m_enabled;
+    copy->m_seed = m_seed;
+    copy->m_search = m_search;
+    copy->m_replacement = m_replacement;
+    return copy;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -120,8 +190,7 @@ void rule_based_transformation::apply(const grid& input, grid& output)
 ////////////////////////////////////////////////////////////////////////////////
 void random_transformation::apply(const grid& input, grid& output)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(m_seed);
     std::uniform_int_distribution<int> dis(0, m_alphabet->get_symbols().size() - 1);
 
     // Ensure output grid has the same dimensions as input
@@ -133,12 +202,67 @@ void random_transformation::apply(const grid& input, grid& output)
     for(int i = 0; i < output.width(); ++i)
         for(int j = 0; j < output.height(); ++j)
             output(i, j) = m_alphabet->get_symbols()[dis(gen)].id;
+
+    m_statistics.matches = 0;
+    m_statistics.cells_written = (size_t)output.width() * output.height();
+}
+
+std::unique_ptr<transformation> random_transformation::clone(std::shared_ptr<alphabet> alphabet) const
+{
+    auto copy = std::make_unique<random_transformation>(m_name, std::move(alphabet));
+    copy->m_enabled = m_enabled;
+    copy->m_seed = m_seed;
+    return copy;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////                             grid_synth
 ////////////////////////////////////////////////////////////////////////////////
-void grid_synth::synthesize()
+namespace
+{
+    nlohmann::json transformation_to_json(const transformation& t)
+    {
+        nlohmann::json t_json;
+
+        // Common transformation properties
+        t_json["name"] = t.name();
+        t_json["enabled"] = t.enabled();
+
+        if (t.type() == transformation::Type::RANDOM) {
+            t_json["type"] = "random";
+        }
+        else if (t.type() == transformation::Type::RULE_BASED) {
+            auto* rule_t = static_cast<const rule_based_transformation*>(&t);
+            t_json["type"] = "rule_based";
+
+            // Serialize search pattern
+            const grid& search = rule_t->get_search();
+            t_json["search"] = {
+                {"width", search.width()},
+                {"height", search.height()},
+                {"data", search.data()}
+            };
+
+            // Serialize replacements
+            t_json["replacements"] = nlohmann::json::array();
+            for (const auto& repl : rule_t->replacements()) {
+                const grid& repl_grid = repl.replacement;
+                t_json["replacements"].push_back({
+                    {"probability", repl.probability},
+                    {"grid", {
+                        {"width", repl_grid.width()},
+                        {"height", repl_grid.height()},
+                        {"data", repl_grid.data()}
+                    }}
+                });
+            }
+        }
+
+        return t_json;
+    }
+}
+
+bool grid_synth::synthesize(const synthesis_control& control)
 {
     // Create a buffer grid with the same dimensions as the main grid
     grid buffer(m_grid.width(), m_grid.height());
@@ -147,12 +271,90 @@ void grid_synth::synthesize()
     grid* input = &m_grid;
     grid* output = &buffer;
 
-    for(auto& t : m_transformations)
+    size_t total = 0, done = 0;
+    for (const auto& t : m_transformations)
+        if (t->enabled())
+            total++;
+
+    // Resume after the last stage whose output is cached
+    std::vector<uint64_t> keys;
+    if (control.stages || control.thumbnails)
+        keys = stage_keys();
+
+    if (control.timeline) {
+        control.timeline->clear();
+        control.timeline->record(0, "Input", m_grid);
+    }
+
+    size_t first = 0;
+    if (control.stages) {
+        for (size_t i = keys.size(); i-- > 0;) {
+            if (m_transformations[i]->enabled() && control.stages->find(keys[i], m_grid)) {
+                first = i + 1;
+                break;
+            }
+        }
+        for (size_t i = 0; i < first; ++i)
+            if (m_transformations[i]->enabled())
+                done++;
+    }
+
+    if (control.profile) {
+        control.profile->clear();
+        for (size_t i = 0; i < first; ++i)
+            if (m_transformations[i]->enabled())
+                control.profile->push_back({i, m_transformations[i]->name(), 0.0, 0, 0, true});
+    }
+
+    if (control.thumbnails)
+        control.thumbnails->clear();
+    if (control.thumbnails || control.timeline) {
+        grid cached(0, 0);
+        for (size_t i = 0; i < first; ++i) {
+            if (!m_transformations[i]->enabled())
+                continue;
+            // The last cached output is already in m_grid
+            const grid* source = &m_grid;
+            if (i + 1 < first) {
+                if (!control.stages->find(keys[i], cached))
+                    continue;
+                source = &cached;
+            }
+            if (control.thumbnails)
+                control.thumbnails->push_back({i, keys[i], make_thumbnail(*source, control.thumbnail_size)});
+            if (control.timeline)
+                control.timeline->record(i, m_transformations[i]->name() + " (cached)", *source);
+        }
+    }
+
+    for(size_t i = first; i < m_transformations.size(); ++i)
     {
+        auto& t = m_transformations[i];
         if (t->enabled())
         {
+            if (control.cancel && control.cancel->load())
+                return false;
+            if (control.progress)
+                control.progress(done++, total);
+
+            // Derive a stable per-stage seed so stages don't share a sequence
+            t->set_seed((uint32_t)hash_combine(m_seed, i));
+
             // Apply transformation from input to output
+            auto start = std::chrono::steady_clock::now();
             t->apply(*input, *output);
+            if (control.profile) {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                const auto& stats = t->last_statistics();
+                control.profile->push_back({i, t->name(), elapsed.count(),
+                                            stats.matches, stats.cells_written, false});
+            }
+            if (control.stages)
+                control.stages->store(keys[i], *output);
+            if (control.thumbnails)
+                control.thumbnails->push_back({i, keys[i], make_thumbnail(*output, control.thumbnail_size)});
+            if (control.timeline)
+                control.timeline->record(i, t->name(), *output);
 
             // Swap buffers for next transformation
             std::swap(input, output);
@@ -168,11 +370,68 @@ void grid_synth::synthesize()
             }
         }
     }
+
+    if (control.progress)
+        control.progress(total, total);
+    return true;
+}
+
+std::vector<uint64_t> grid_synth::stage_keys() const
+{
+    // Everything a stage may depend on besides its own settings
+    uint64_t h = hash_combine(engine_version, m_alphabet->symbols().size());
+    for (const auto& [id, s] : m_alphabet->symbols())
+        h = hash_string(s.name, hash_combine(h, (uint64_t)id));
+    h = hash_combine(h, hash_combine(m_grid.width(), m_grid.height()));
+    h = hash_bytes(m_grid.raw_data(), (size_t)m_grid.width() * m_grid.height() * sizeof(int), h);
+
+    std::vector<uint64_t> keys;
+    keys.reserve(m_transformations.size());
+    for (size_t i = 0; i < m_transformations.size(); ++i) {
+        const auto& t = m_transformations[i];
+        if (t->enabled()) {
+            uint64_t stage_seed = (uint32_t)hash_combine(m_seed, i);
+            h = hash_string(transformation_to_json(*t).dump(), hash_combine(h, stage_seed));
+        }
+        keys.push_back(h);
+    }
+    return keys;
+}
+
+size_t grid_synth::first_changed_stage(const grid_synth& other) const
+{
+    const size_t size = std::max(m_transformations.size(), other.m_transformations.size());
+    if (m_seed != other.m_seed || m_alphabet->symbols().size() != other.m_alphabet->symbols().size())
+        return 0;
+    for (const auto& [id, s] : m_alphabet->symbols()) {
+        auto it = other.m_alphabet->symbols().find(id);
+        if (it == other.m_alphabet->symbols().end() || it->second.name != s.name)
+            return 0;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (i >= m_transformations.size() || i >= other.m_transformations.size())
+            return i;
+        if (transformation_to_json(*m_transformations[i]) != transformation_to_json(*other.m_transformations[i]))
+            return i;
+    }
+    return size;
+}
+
+grid_synth grid_synth::clone() const
+{
+    grid_synth copy(m_grid.width(), m_grid.height());
+    copy.m_grid = m_grid;
+    copy.m_alphabet = std::make_shared<alphabet>(*m_alphabet);
+    copy.m_seed = m_seed;
+    for (const auto& t : m_transformations)
+        copy.m_transformations.push_back(t->clone(copy.m_alphabet));
+    return copy;
 }
 
 nlohmann::json grid_synth::to_json() const
 {
-    nlohmann::json j;
+    nlohmann::json j = pipeline_to_json();
 
     // Store version info
     j["version"] = 1;
@@ -184,6 +443,16 @@ nlohmann::json grid_synth::to_json() const
         {"data", m_grid.data()}
     };
 
+    return j;
+}
+
+nlohmann::json grid_synth::pipeline_to_json() const
+{
+    nlohmann::json j;
+
+    // Serialize seed
+    j["seed"] = m_seed;
+
     // Serialize alphabet
     j["alphabet"] = {{"symbols", nlohmann::json::array()}};
     for (const auto& [id, s] : m_alphabet->symbols()) {
@@ -195,47 +464,89 @@ nlohmann::json grid_synth::to_json() const
 
     // Serialize transformations
     j["transformations"] = nlohmann::json::array();
-    for (const auto& t : m_transformations) {
-        nlohmann::json t_json;
+    for (const auto& t : m_transformations)
+        j["transformations"].push_back(transformation_to_json(*t));
 
-        // Common transformation properties
-        t_json["name"] = t->name();
-        t_json["enabled"] = t->enabled();
+    return j;
+}
 
-        if (t->type() == transformation::Type::RANDOM) {
-            t_json["type"] = "random";
-        }
-        else if (t->type() == transformation::Type::RULE_BASED) {
-            auto* rule_t = static_cast<const rule_based_transformation*>(t.get());
-            t_json["type"] = "rule_based";
+void grid_synth::load_pipeline(const nlohmann::json& j)
+{
+    // Parse into a fresh synthesizer so a bad pipeline leaves this one untouched
+    grid_synth parsed(0, 0);
+
+    // Seed is optional, older files don't have it
+    parsed.m_seed = j.value("seed", 0u);
+
+    // Parse alphabet
+    for (const auto& symbol_json : j["alphabet"]["symbols"]) {
+        symbol s;
+        s.id = symbol_json["id"];
+        s.name = symbol_json["name"];
+        parsed.m_alphabet->add_symbol(s);
+    }
 
-            // Serialize search pattern
-            const grid& search = rule_t->get_search();
-            t_json["search"] = {
-                {"width", search.width()},
-                {"height", search.height()},
-                {"data", search.data()}
-            };
+    // Parse transformations
+    for (const auto& t_json : j["transformations"]) {
+        std::string type = t_json["type"];
+        std::string name = t_json["name"];
+        bool enabled = t_json["enabled"];
 
-            // Serialize replacements
-            t_json["replacements"] = nlohmann::json::array();
-            for (const auto& repl : rule_t->replacements()) {
-                const grid& repl_grid = repl.replacement;
-                t_json["replacements"].push_back({
-                    {"probability", repl.probability},
-                    {"grid", {
-                        {"width", repl_grid.width()},
-                        {"height", repl_grid.height()},
-                        {"data", repl_grid.data()}
-                    }}
-                });
-            }
+        if (type == "random") {
+            auto t = std::make_unique<random_transformation>(name, parsed.m_alphabet);
+            t->set_enabled(enabled);
+            parsed.add_transformation(std::move(t));
         }
+        else if (type == "rule_based") {
+            auto t = std::make_unique<rule_based_transformation>(name, parsed.m_alphabet);
+            t->set_enabled(enabled);
+
+            // Parse search pattern
+            int search_width = t_json["search"]["width"];
+            int search_height = t_json["search"]["height"];
+            std::vector<int> search_data = t_json["search"]["data"];
+
+            grid search_grid(search_width, search_height);
+            // Properly set search grid data
+            for (int y = 0; y < search_height; ++y) {
+                for (int x = 0; x < search_width; ++x) {
+                    int index = y * search_width + x;
+                    if (index < (int)search_data.size()) {
+                        search_grid.set(x, y, search_data[index]);
+                    }
+                }
+            }
+            t->set_search(search_grid);
+
+            // Parse replacements
+            for (const auto& repl_json : t_json["replacements"]) {
+                float probability = repl_json["probability"];
+
+                int repl_width = repl_json["grid"]["width"];
+                int repl_height = repl_json["grid"]["height"];
+                std::vector<int> repl_data = repl_json["grid"]["data"];
+
+                grid repl_grid(repl_width, repl_height);
+                // Properly set replacement grid data
+                for (int y = 0; y < repl_height; ++y) {
+                    for (int x = 0; x < repl_width; ++x) {
+                        int index = y * repl_width + x;
+                        if (index < (int)repl_data.size()) {
+                            repl_grid.set(x, y, repl_data[index]);
+                        }
+                    }
+                }
 
-        j["transformations"].push_back(t_json);
+                t->add_replacement(probability, repl_grid);
+            }
+
+            parsed.add_transformation(std::move(t));
+        }
     }
 
-    return j;
+    m_seed = parsed.m_seed;
+    m_alphabet = std::move(parsed.m_alphabet);
+    m_transformations = std::move(parsed.m_transformations);
 }
 
 grid_synth grid_synth::from_json(const nlohmann::json& j)
@@ -265,71 +576,8 @@ grid_synth grid_synth::from_json(const nlohmann::json& j)
             }
         }
 
-        // Parse alphabet
-        for (const auto& symbol_json : j["alphabet"]["symbols"]) {
-            symbol s;
-            s.id = symbol_json["id"];
-            s.name = symbol_json["name"];
-            synth.m_alphabet->add_symbol(s);
-        }
-
-        // Parse transformations
-        for (const auto& t_json : j["transformations"]) {
-            std::string type = t_json["type"];
-            std::string name = t_json["name"];
-            bool enabled = t_json["enabled"];
-
-            if (type == "random") {
-                auto t = std::make_unique<random_transformation>(name, synth.m_alphabet);
-                t->set_enabled(enabled);
-                synth.add_transformation(std::move(t));
-            }
-            else if (type == "rule_based") {
-                auto t = std::make_unique<rule_based_transformation>(name, synth.m_alphabet);
-                t->set_enabled(enabled);
-
-                // Parse search pattern
-                int search_width = t_json["search"]["width"];
-                int search_height = t_json["search"]["height"];
-                std::vector<int> search_data = t_json["search"]["data"];
-
-                grid search_grid(search_width, search_height);
-                // Properly set search grid data
-                for (int y = 0; y < search_height; ++y) {
-                    for (int x = 0; x < search_width; ++x) {
-                        int index = y * search_width + x;
-                        if (index < (int)search_data.size()) {
-                            search_grid.set(x, y, search_data[index]);
-                        }
-                    }
-                }
-                t->set_search(search_grid);
-
-                // Parse replacements
-                for (const auto& repl_json : t_json["replacements"]) {
-                    float probability = repl_json["probability"];
-
-                    int repl_width = repl_json["grid"]["width"];
-                    int repl_height = repl_json["grid"]["height"];
-                    std::vector<int> repl_data = repl_json["grid"]["data"];
-
-                    grid repl_grid(repl_width, repl_height);
-                    // Properly set replacement grid data
-                    for (int y = 0; y < repl_height; ++y) {
-                        for (int x = 0; x < repl_width; ++x) {
-                            int index = y * repl_width + x;
-                            if (index < (int)repl_data.size()) {
-                                repl_grid.set(x, y, repl_data[index]);
-                            }
-                        }
-                    }
-
-                    t->add_replacement(probability, repl_grid);
-                }
-
-                synth.add_transformation(std::move(t));
-            }
-        }
+        // Seed, alphabet and transformations
+        synth.load_pipeline(j);
 
         return synth;
     }
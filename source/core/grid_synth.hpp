@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <unordered_map>
 #include <map>
 #include <memory>
@@ -11,6 +14,12 @@
 namespace gs
 {
 
+/// @brief Version of the synthesis engine
+///
+/// Bump this whenever a change alters the output of an existing pipeline,
+/// so that cached results produced by older builds are no longer used.
+constexpr int engine_version = 1;
+
 ////////////////////////////////////////////////////////////////////////////////
 ////                                grid
 ////////////////////////////////////////////////////////////////////////////////
@@ -49,6 +58,15 @@ public:
         return *this;
     }
 
+    /// @brief Move constructor
+    /// @param other The grid to move from
+    grid(grid&& other) noexcept = default;
+
+    /// @brief Move assignment operator
+    /// @param other The grid to move from
+    /// @return Reference to this grid
+    grid& operator=(grid&& other) noexcept = default;
+
     /// @brief Get the value at a specific position
     /// @param x The x coordinate
     /// @param y The y coordinate
@@ -101,6 +119,14 @@ public:
     /// @return A copy of the internal data vector
     std::vector<int> data() const { return m_data; }
 
+    /// @brief Direct access to the cell values, stored row by row
+    /// @return Pointer to the first cell
+    int* raw_data() { return m_data.data(); }
+
+    /// @brief Direct access to the cell values, stored row by row (const)
+    /// @return Pointer to the first cell
+    const int* raw_data() const { return m_data.data(); }
+
 private:
     int m_width;
     int m_height;
@@ -149,7 +175,7 @@ public:
 
     /// @brief Remove a symbol from the alphabet
     /// @param id The ID of the symbol to remove
-    void remove_symbol(int id) { m_symbols.erase(id); }
+    void remove_symbol(int id);
 
     /// @brief Get a symbol by its ID
     /// @param id The ID of the symbol to retrieve
@@ -158,8 +184,8 @@ public:
     const symbol& get_symbol(int id) const { return m_symbols.at(id); }
 
     /// @brief Get all symbols in the alphabet
-    /// @return A vector containing all symbols
-    const std::vector<symbol>& get_symbols() const;
+    /// @return A vector containing all symbols, ordered by ID
+    const std::vector<symbol>& get_symbols() const { return m_symbol_list; }
 
     /// @brief The empty symbol (ID = 0)
     const static symbol empty_symbol;
@@ -171,8 +197,21 @@ public:
     /// @return The map of symbols
     const std::map<int, symbol>& symbols() const { return m_symbols; }
 
+    /// @brief Get the version of the alphabet
+    ///
+    /// Changes whenever a symbol is added or removed. Versions are unique
+    /// across all alphabets, so caches keyed by it also notice when an
+    /// alphabet is replaced by another one.
+    /// @return The version
+    uint64_t version() const { return m_version; }
+
 private:
+    /// @brief Rebuild the ordered symbol list after a change
+    void update_symbol_list();
+
     std::map<int, symbol> m_symbols;
+    std::vector<symbol> m_symbol_list;
+    uint64_t m_version;
 };
 
 
@@ -218,6 +257,15 @@ public:
     /// @param enabled The new enabled state
     void set_enabled(bool enabled) { m_enabled = enabled; }
 
+    /// @brief Get the seed used for the random generator
+    /// @return The seed
+    uint32_t seed() const { return m_seed; }
+
+    /// @brief Set the seed used for the random generator
+    /// @param seed The new seed
+    /// @note grid_synth::synthesize() derives this from the pipeline seed
+    void set_seed(uint32_t seed) { m_seed = seed; }
+
     /// @brief Transformation types for serialization
     enum class Type {
         RANDOM,
@@ -228,9 +276,26 @@ public:
     /// @return The transformation type
     virtual Type type() const = 0;
 
+    /// @brief Create a deep copy of the transformation
+    /// @param alphabet The alphabet the copy should use
+    /// @return The copy
+    virtual std::unique_ptr<transformation> clone(std::shared_ptr<alphabet> alphabet) const = 0;
+
+    /// @brief Counters of the last apply() call
+    struct statistics {
+        size_t matches = 0;         ///< Places where the search pattern matched
+        size_t cells_written = 0;   ///< Output cells set by the transformation
+    };
+
+    /// @brief Get the counters of the last apply() call
+    /// @return The counters
+    const statistics& last_statistics() const { return m_statistics; }
+
 protected:
     std::string m_name;
     bool m_enabled = true;
+    uint32_t m_seed = 0;
+    statistics m_statistics;
     std::shared_ptr<alphabet> m_alphabet;
 };
 
@@ -262,6 +327,11 @@ public:
     /// @brief Get the type of transformation
     /// @return Type::RANDOM
     Type type() const override { return Type::RANDOM; }
+
+    /// @brief Create a deep copy of the transformation
+    /// @param alphabet The alphabet the copy should use
+    /// @return The copy
+    std::unique_ptr<transformation> clone(std::shared_ptr<alphabet> alphabet) const override;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -339,10 +409,32 @@ public:
     /// @param output The output grid where matches will be replaced
     void apply(const grid& input, grid& output) override;
 
+    /// @brief Apply the rule to a region of a grid only
+    ///
+    /// Only positions whose replacement can reach the region are tested, so
+    /// the cost depends on the size of the region and not of the grid. The
+    /// matches are the same as with apply(), but replacements are picked with
+    /// a random sequence of their own. The result equals the same region of a
+    /// full run only when the rule has a single replacement with probability
+    /// >= 1.
+    /// @param input The input grid
+    /// @param output Receives the region after the rule was applied
+    /// @param x0 Left column of the region
+    /// @param y0 Top row of the region
+    /// @param x1 Right column of the region, inclusive
+    /// @param y1 Bottom row of the region, inclusive
+    /// @return The number of matches reaching the region
+    size_t apply_region(const grid& input, grid& output, int x0, int y0, int x1, int y1) const;
+
     /// @brief Get the type of transformation
     /// @return Type::RULE_BASED
     Type type() const override { return Type::RULE_BASED; }
 
+    /// @brief Create a deep copy of the transformation
+    /// @param alphabet The alphabet the copy should use
+    /// @return The copy
+    std::unique_ptr<transformation> clone(std::shared_ptr<alphabet> alphabet) const override;
+
     /// @brief Replacement entry structure
     struct replacement_entry {
         float probability;   ///< Probability of this replacement (0.0-1.0)
@@ -354,10 +446,71 @@ public:
     const std::vector<replacement_entry>& replacements() const { return m_replacement; }
 
 private:
+    const grid* pick_replacement(float r) const;
+
     grid m_search;
     std::vector<replacement_entry> m_replacement;
 };
 
+class stage_cache;
+class synthesis_timeline;
+
+/// @brief Where the time of one stage of a synthesis went
+struct stage_profile
+{
+    size_t index;               ///< Position of the stage in the pipeline
+    std::string name;           ///< Name of the transformation
+    double seconds;             ///< Wall-clock time of apply(), 0 if cached
+    size_t matches;             ///< See transformation::statistics
+    size_t cells_written;       ///< See transformation::statistics
+    bool cached;                ///< Whether the output came from the stage cache
+};
+
+/// @brief Downsampled output of one stage of a synthesis
+struct stage_thumbnail
+{
+    size_t index;               ///< Position of the stage in the pipeline
+    uint64_t key;               ///< Stage key, see grid_synth::stage_keys()
+    grid image;                 ///< Every n-th cell of the stage output
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////                          synthesis_control
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Progress reporting and cancellation of a running synthesis
+///
+/// Both are handled between stages, so a long stage delays cancellation
+/// until it finishes.
+struct synthesis_control
+{
+    /// @brief Called before each enabled stage and once after the last one,
+    /// with the number of stages done and the number of enabled stages
+    std::function<void(size_t done, size_t total)> progress;
+
+    /// @brief Synthesis stops at the next stage once this is set
+    const std::atomic<bool>* cancel = nullptr;
+
+    /// @brief Optional cache of stage outputs, synthesis resumes after the
+    /// last stage found in it and stores the outputs of the stages it runs
+    stage_cache* stages = nullptr;
+
+    /// @brief Optional list receiving one entry per enabled stage, cleared
+    /// when synthesis starts
+    std::vector<stage_profile>* profile = nullptr;
+
+    /// @brief Optional list receiving a thumbnail of every enabled stage,
+    /// cleared when synthesis starts. Thumbnails of stages resumed from the
+    /// stage cache are made from the cached outputs.
+    std::vector<stage_thumbnail>* thumbnails = nullptr;
+
+    /// @brief Largest side of the thumbnails in cells
+    int thumbnail_size = 64;
+
+    /// @brief Optional recording of the input and every stage output,
+    /// cleared when synthesis starts
+    synthesis_timeline* timeline = nullptr;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////                            grid_synth
 ////////////////////////////////////////////////////////////////////////////////
@@ -385,7 +538,8 @@ public:
     grid_synth(grid_synth&& other) noexcept
         : m_grid(std::move(other.m_grid)),
           m_alphabet(std::move(other.m_alphabet)),
-          m_transformations(std::move(other.m_transformations))
+          m_transformations(std::move(other.m_transformations)),
+          m_seed(other.m_seed)
     {}
 
     /// @brief Move assignment operator
@@ -397,6 +551,7 @@ public:
             m_grid = std::move(other.m_grid);
             m_alphabet = std::move(other.m_alphabet);
             m_transformations = std::move(other.m_transformations);
+            m_seed = other.m_seed;
         }
         return *this;
     }
@@ -405,6 +560,13 @@ public:
     grid_synth(const grid_synth&) = delete;
     grid_synth& operator=(const grid_synth&) = delete;
 
+    /// @brief Create a deep copy of the synthesizer
+    ///
+    /// The copy gets its own alphabet and transformations, so it can be
+    /// synthesized on another thread while this one keeps being edited.
+    /// @return The copy
+    grid_synth clone() const;
+
     /// @brief Get the alphabet
     /// @return Shared pointer to the alphabet
     std::shared_ptr<alphabet> get_alphabet() { return m_alphabet; }
@@ -413,6 +575,10 @@ public:
     /// @return Reference to the grid
     grid& get_grid() { return m_grid; }
 
+    /// @brief Get the grid (const)
+    /// @return Reference to the grid
+    const grid& get_grid() const { return m_grid; }
+
     /// @brief Add a transformation to the pipeline
     /// @param t The transformation to add
     void add_transformation(std::unique_ptr<transformation> t)
@@ -428,13 +594,55 @@ public:
     std::vector<std::unique_ptr<transformation>>& get_transformations()
     { return m_transformations; }
 
+    /// @brief Get the pipeline seed
+    /// @return The seed
+    uint32_t seed() const { return m_seed; }
+
+    /// @brief Set the pipeline seed
+    /// @param seed The new seed
+    void set_seed(uint32_t seed) { m_seed = seed; }
+
     /// @brief Apply all enabled transformations to the grid
-    void synthesize();
+    ///
+    /// Each transformation is seeded from the pipeline seed and its position
+    /// in the stack, so the same pipeline, seed and input grid always produce
+    /// the same result.
+    /// @param control Optional progress callback and cancellation flag
+    /// @return True if all stages ran, false if cancelled, in which case the
+    ///         grid is left in an intermediate state
+    bool synthesize(const synthesis_control& control = {});
+
+    /// @brief Compute cache keys for the output of every stage
+    ///
+    /// Key i identifies the output after stage i, chaining the engine
+    /// version, the alphabet, the current grid and every enabled stage up to
+    /// i with its seed. A disabled stage repeats the key before it.
+    /// @return One key per transformation
+    std::vector<uint64_t> stage_keys() const;
+
+    /// @brief Compare the pipeline with another one, ignoring the grids
+    ///
+    /// A change to the seed or the alphabet affects every stage, as does
+    /// moving a stage, since stages are seeded by their position.
+    /// @param other The pipeline to compare with
+    /// @return Index of the first stage that differs, the number of stages
+    ///         of the longer pipeline if they are the same
+    size_t first_changed_stage(const grid_synth& other) const;
 
     /// @brief Convert to JSON
     /// @return JSON representation of the grid_synth
     nlohmann::json to_json() const;
 
+    /// @brief Convert the pipeline (seed, alphabet and transformations) to JSON
+    /// @return JSON representation of everything but the grid
+    nlohmann::json pipeline_to_json() const;
+
+    /// @brief Replace the seed, alphabet and transformations from JSON, keeping the grid
+    /// @param j The JSON to parse, as written by pipeline_to_json()
+    /// @throws nlohmann::json::exception if the JSON is invalid, the
+    ///         synthesizer is left unchanged in that case
+    void load_pipeline(const nlohmann::json& j);
+
     /// @brief Create a grid_synth from JSON
     /// @param j The JSON to parse
     /// @return A new grid_synth instance
@@ -444,6 +652,7 @@ protected:
     grid m_grid;
     std::shared_ptr<alphabet> m_alphabet = std::make_shared<alphabet>();
     std::vector<std::unique_ptr<transformation>> m_transformations;
+    uint32_t m_seed = 0;
 };
 
 }
\ No newline at end of file
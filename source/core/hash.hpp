@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace gs
+{
+
+/// @brief Mix two 64-bit values into one
+///
+/// Uses the splitmix64 finalizer, which spreads every input bit over the
+/// whole result. Suitable for deriving seeds and building cache keys.
+/// @param a The first value
+/// @param b The second value
+/// @return The mixed value
+inline uint64_t hash_combine(uint64_t a, uint64_t b)
+{
+    uint64_t z = a + 0x9e3779b97f4a7c15ull + (b << 6) + (b >> 2) + b;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/// @brief Hash a block of bytes
+///
+/// Consumes eight bytes at a time, so hashing a large grid stays cheap.
+/// @param data Pointer to the bytes
+/// @param size Number of bytes
+/// @param seed Initial hash value
+/// @return The 64-bit hash
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = hash_combine(seed, size);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        h = hash_combine(h, word);
+    }
+    uint64_t tail = 0;
+    if (i < size)
+        std::memcpy(&tail, bytes + i, size - i);
+    return hash_combine(h, tail);
+}
+
+/// @brief Hash a string
+/// @param s The string to hash
+/// @param seed Initial hash value
+/// @return The 64-bit hash
+inline uint64_t hash_string(const std::string& s, uint64_t seed = 0)
+{
+    return hash_bytes(s.data(), s.size(), seed);
+}
+
+}
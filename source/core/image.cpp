@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include "image.hpp"
+
+using namespace gs;
+
+namespace
+{
+    void put_u32_be(std::vector<uint8_t>& out, uint32_t v)
+    {
+        out.push_back((uint8_t)(v >> 24));
+        out.push_back((uint8_t)(v >> 16));
+        out.push_back((uint8_t)(v >> 8));
+        out.push_back((uint8_t)v);
+    }
+
+    void write_chunk(std::ostream& out, const char type[4], const uint8_t* data, size_t size)
+    {
+        std::vector<uint8_t> header;
+        put_u32_be(header, (uint32_t)size);
+        header.insert(header.end(), type, type + 4);
+
+        uint32_t crc = crc32(header.data() + 4, 4);
+        crc = crc32(data, size, crc);
+        std::vector<uint8_t> footer;
+        put_u32_be(footer, crc);
+
+        out.write(reinterpret_cast<const char*>(header.data()), header.size());
+        out.write(reinterpret_cast<const char*>(data), size);
+        out.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+    }
+
+    /// Palette extended with every symbol that appears in the grid
+    palette complete_palette(const grid& g, const palette& p)
+    {
+        palette local = p;
+        const int* cells = g.raw_data();
+        const size_t count = (size_t)g.width() * g.height();
+        int last = 0;
+        bool has_last = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (has_last && cells[i] == last)
+                continue;
+            last = cells[i];
+            has_last = true;
+            if (local.index_of(last) < 0)
+                local.set(last, p.get(last));
+        }
+        return local;
+    }
+}
+
+image_format gs::image_format_from_filename(const std::string& filename)
+{
+    std::string ext = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".ppm" ? image_format::ppm : image_format::png;
+}
+
+void gs::write_ppm(std::ostream& out, const grid& g, const palette& p, const image_options& options)
+{
+    const int scale = std::max(1, options.scale);
+    const int width = g.width() * scale;
+    const int height = g.height() * scale;
+    out << "P6\n" << width << " " << height << "\n255\n";
+
+    // Build one row of pixels per grid row and write it scale times
+    std::vector<uint8_t> row((size_t)width * 3);
+    for (int y = 0; y < g.height(); ++y) {
+        uint8_t* px = row.data();
+        for (int x = 0; x < g.width(); ++x) {
+            color c = p.get(g(x, y));
+            for (int s = 0; s < scale; ++s) {
+                *px++ = c.r;
+                *px++ = c.g;
+                *px++ = c.b;
+            }
+        }
+        for (int s = 0; s < scale; ++s)
+            out.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    if (!out)
+        throw std::runtime_error("Failed to write PPM image");
+}
+
+void gs::write_png(std::ostream& out, const grid& g, const palette& p, const image_options& options)
+{
+    const int scale = std::max(1, options.scale);
+    const int width = g.width() * scale;
+    const int height = g.height() * scale;
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Can't write an empty PNG image");
+
+    palette local = complete_palette(g, p);
+    const bool indexed = local.size() <= 256;
+    const int bytes_per_pixel = indexed ? 1 : 3;
+    const size_t stride = 1 + (size_t)width * bytes_per_pixel;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<uint8_t> ihdr;
+    put_u32_be(ihdr, (uint32_t)width);
+    put_u32_be(ihdr, (uint32_t)height);
+    ihdr.push_back(8);                  // Bit depth
+    ihdr.push_back(indexed ? 3 : 2);    // Color type: palette or RGB
+    ihdr.push_back(0);                  // Compression
+    ihdr.push_back(0);                  // Filter
+    ihdr.push_back(0);                  // Interlace
+    write_chunk(out, "IHDR", ihdr.data(), ihdr.size());
+
+    if (indexed) {
+        std::vector<uint8_t> plte;
+        for (int i = 0; i < local.size(); ++i) {
+            color c = local.color_at(i);
+            plte.push_back(c.r);
+            plte.push_back(c.g);
+            plte.push_back(c.b);
+        }
+        write_chunk(out, "PLTE", plte.data(), plte.size());
+    }
+
+    // Unfiltered scanlines; the deflate matcher picks up the row above via the hint
+    std::vector<uint8_t> raw(stride * height);
+    for (int y = 0; y < g.height(); ++y) {
+        uint8_t* row = raw.data() + (size_t)y * scale * stride;
+        row[0] = 0;
+        uint8_t* px = row + 1;
+        for (int x = 0; x < g.width(); ++x) {
+            int id = g(x, y);
+            if (indexed) {
+                std::fill(px, px + scale, (uint8_t)local.index_of(id));
+                px += scale;
+            }
+            else {
+                color c = local.get(id);
+                for (int s = 0; s < scale; ++s) {
+                    *px++ = c.r;
+                    *px++ = c.g;
+                    *px++ = c.b;
+                }
+            }
+        }
+        for (int s = 1; s < scale; ++s)
+            std::copy(row, row + stride, row + s * stride);
+    }
+
+    std::vector<uint8_t> idat = zlib_compress(raw.data(), raw.size(), options.compression, stride);
+    const size_t max_chunk = 1 << 20;
+    for (size_t pos = 0; pos < idat.size(); pos += max_chunk)
+        write_chunk(out, "IDAT", idat.data() + pos, std::min(max_chunk, idat.size() - pos));
+    write_chunk(out, "IEND", nullptr, 0);
+
+    if (!out)
+        throw std::runtime_error("Failed to write PNG image");
+}
+
+bool gs::save_image(const std::string& filename, const grid& g, const palette& p, const image_options& options)
+{
+    try {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file for writing: " << filename << std::endl;
+            return false;
+        }
+
+        if (image_format_from_filename(filename) == image_format::ppm)
+            write_ppm(file, g, p, options);
+        else
+            write_png(file, g, p, options);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error saving image: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+size_t gs::save_images(const std::vector<const grid*>& grids,
+                       const std::vector<std::string>& filenames,
+                       const palette& p,
+                       const image_options& options,
+                       int threads)
+{
+    std::atomic<size_t> saved{0};
+    parallel_for(std::min(grids.size(), filenames.size()), [&](size_t i) {
+        if (save_image(filenames[i], *grids[i], p, options))
+            saved++;
+    }, threads);
+    return saved;
+}
+
+batch_sink gs::image_sink(const std::string& directory, image_format format,
+                          const palette& p, const image_options& options)
+{
+    std::string extension = format == image_format::ppm ? ".ppm" : ".png";
+    return [directory, extension, p, options](const batch_result& result) {
+        save_image(directory + "/" + std::to_string(result.seed) + extension, result.output, p, options);
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            image import
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    /// Exact-color hash table from packed RGB to symbol IDs
+    class color_lookup
+    {
+    public:
+        color_lookup(const palette& p, const image_import_options& options)
+            : m_options(options)
+        {
+            for (int i = 0; i < p.size(); ++i) {
+                color c = p.color_at(i);
+                m_table.emplace(pack(c.r, c.g, c.b), p.id_at(i));
+            }
+        }
+
+        int find(uint8_t r, uint8_t g, uint8_t b)
+        {
+            // Neighbouring pixels are usually the same color
+            uint32_t key = pack(r, g, b);
+            if (m_has_last && key == m_last_key)
+                return m_last_id;
+
+            auto it = m_table.find(key);
+            int id;
+            if (it != m_table.end()) {
+                id = it->second;
+            }
+            else if (m_options.strict) {
+                char msg[64];
+                std::snprintf(msg, sizeof(msg), "Color #%02x%02x%02x is not in the palette", r, g, b);
+                throw std::runtime_error(msg);
+            }
+            else {
+                id = m_options.unknown_symbol;
+            }
+
+            m_last_key = key;
+            m_last_id = id;
+            m_has_last = true;
+            return id;
+        }
+
+    private:
+        static uint32_t pack(uint8_t r, uint8_t g, uint8_t b) { return (uint32_t)r << 16 | (uint32_t)g << 8 | b; }
+
+        const image_import_options& m_options;
+        std::unordered_map<uint32_t, int> m_table;
+        uint32_t m_last_key = 0;
+        int m_last_id = 0;
+        bool m_has_last = false;
+    };
+
+    /// Skip whitespace and comments, then read an unsigned integer of a PPM header
+    int read_ppm_number(std::istream& in)
+    {
+        int c = in.get();
+        while (c != EOF) {
+            if (c == '#') {
+                while (c != EOF && c != '\n')
+                    c = in.get();
+            }
+            else if (!std::isspace(c)) {
+                break;
+            }
+            c = in.get();
+        }
+        if (!std::isdigit(c))
+            throw std::runtime_error("Invalid PPM header");
+
+        int64_t v = 0;
+        while (std::isdigit(c)) {
+            v = v * 10 + (c - '0');
+            if (v > INT32_MAX)
+                throw std::runtime_error("Invalid PPM header");
+            c = in.get();
+        }
+        return (int)v;
+    }
+
+    uint32_t read_u32_be(std::istream& in)
+    {
+        uint8_t b[4];
+        in.read(reinterpret_cast<char*>(b), 4);
+        if (!in)
+            throw std::runtime_error("Unexpected end of PNG file");
+        return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3];
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return (uint8_t)a;
+        return (uint8_t)(pb <= pc ? b : c);
+    }
+
+    void unfilter(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t length, size_t bpp)
+    {
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < length; ++i)
+                    row[i] = (uint8_t)(row[i] + row[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < length; ++i)
+                    row[i] = (uint8_t)(row[i] + prev[i]);
+                break;
+            case 3:
+                for (size_t i = 0; i < length; ++i)
+                    row[i] = (uint8_t)(row[i] + ((i >= bpp ? row[i - bpp] : 0) + prev[i]) / 2);
+                break;
+            case 4:
+                for (size_t i = 0; i < length; ++i)
+                    row[i] = (uint8_t)(row[i] + paeth(i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0));
+                break;
+            default:
+                throw std::runtime_error("Invalid PNG filter type");
+        }
+    }
+}
+
+grid gs::read_ppm(std::istream& in, const palette& p, const image_import_options& options)
+{
+    char magic[2];
+    in.read(magic, 2);
+    if (!in || magic[0] != 'P' || (magic[1] != '6' && magic[1] != '3'))
+        throw std::runtime_error("Not a PPM image");
+    const bool binary = magic[1] == '6';
+
+    int width = read_ppm_number(in);
+    int height = read_ppm_number(in);
+    int max_value = read_ppm_number(in);
+    if (width <= 0 || height <= 0 || max_value <= 0 || max_value > 65535)
+        throw std::runtime_error("Invalid PPM dimensions");
+    if ((uint64_t)width * height > INT32_MAX)
+        throw std::runtime_error("PPM image is too large");
+
+    const int scale = std::max(1, options.scale);
+    const int bytes_per_sample = max_value > 255 ? 2 : 1;
+    color_lookup lookup(p, options);
+    grid g(width / scale, height / scale);
+
+    // Samples are rescaled to 8 bits
+    auto to_byte = [max_value](int v) { return (uint8_t)(max_value == 255 ? v : v * 255 / max_value); };
+
+    std::vector<uint8_t> row((size_t)width * 3 * bytes_per_sample);
+    for (int y = 0; y < g.height() * scale; ++y) {
+        if (binary) {
+            in.read(reinterpret_cast<char*>(row.data()), row.size());
+            if (!in)
+                throw std::runtime_error("Unexpected end of PPM file");
+        }
+        if (y % scale != 0 && binary)
+            continue;
+
+        for (int x = 0; x < width; ++x) {
+            int rgb[3];
+            for (int c = 0; c < 3; ++c) {
+                if (binary) {
+                    const uint8_t* s = row.data() + ((size_t)x * 3 + c) * bytes_per_sample;
+                    rgb[c] = bytes_per_sample == 2 ? (s[0] << 8 | s[1]) : s[0];
+                }
+                else {
+                    rgb[c] = read_ppm_number(in);
+                }
+            }
+            if (y % scale == 0 && x % scale == 0 && x / scale < g.width())
+                g(x / scale, y / scale) = lookup.find(to_byte(rgb[0]), to_byte(rgb[1]), to_byte(rgb[2]));
+        }
+    }
+    return g;
+}
+
+grid gs::read_png(std::istream& in, const palette& p, const image_import_options& options)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t sig[8];
+    in.read(reinterpret_cast<char*>(sig), 8);
+    if (!in || std::memcmp(sig, signature, 8) != 0)
+        throw std::runtime_error("Not a PNG image");
+
+    int width = 0, height = 0, depth = 0, color_type = -1;
+    std::vector<color> png_palette;
+
+    // Walk the chunks up to the first IDAT
+    uint32_t length = 0;
+    char type[5] = {};
+    for (;;) {
+        length = read_u32_be(in);
+        in.read(type, 4);
+        if (!in)
+            throw std::runtime_error("Unexpected end of PNG file");
+        if (std::strcmp(type, "IDAT") == 0)
+            break;
+
+        // Only the header and the palette are read, the length is untrusted
+        const bool needed = std::strcmp(type, "IHDR") == 0 || std::strcmp(type, "PLTE") == 0;
+        if (!needed) {
+            in.ignore(length);
+            read_u32_be(in);    // CRC
+            if (std::strcmp(type, "IEND") == 0)
+                throw std::runtime_error("PNG image has no image data");
+            continue;
+        }
+        if (length > 256 * 3)
+            throw std::runtime_error("Invalid PNG chunk length");
+
+        std::vector<uint8_t> body(length);
+        in.read(reinterpret_cast<char*>(body.data()), length);
+        read_u32_be(in);    // CRC
+
+        if (std::strcmp(type, "IHDR") == 0 && length >= 13) {
+            width = (int)((uint32_t)body[0] << 24 | body[1] << 16 | body[2] << 8 | body[3]);
+            height = (int)((uint32_t)body[4] << 24 | body[5] << 16 | body[6] << 8 | body[7]);
+            depth = body[8];
+            color_type = body[9];
+            if (body[12] != 0)
+                throw std::runtime_error("Interlaced PNG images are not supported");
+        }
+        else if (std::strcmp(type, "PLTE") == 0) {
+            for (uint32_t i = 0; i + 2 < length; i += 3)
+                png_palette.push_back({body[i], body[i + 1], body[i + 2], 255});
+        }
+    }
+
+    int channels;
+    switch (color_type) {
+        case 0: channels = 1; break;    // Gray
+        case 2: channels = 3; break;    // RGB
+        case 3: channels = 1; break;    // Palette
+        case 4: channels = 2; break;    // Gray + alpha
+        case 6: channels = 4; break;    // RGB + alpha
+        default: throw std::runtime_error("Invalid or missing PNG header");
+    }
+    if (width <= 0 || height <= 0 || (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16))
+        throw std::runtime_error("Invalid PNG dimensions");
+    if ((uint64_t)width * height > INT32_MAX)
+        throw std::runtime_error("PNG image is too large");
+    if (color_type == 3 && png_palette.empty())
+        throw std::runtime_error("PNG image has no palette");
+
+    const int scale = std::max(1, options.scale);
+    const size_t bits_per_pixel = (size_t)channels * depth;
+    const size_t stride = ((size_t)width * bits_per_pixel + 7) / 8;
+    const size_t bpp = std::max<size_t>(1, bits_per_pixel / 8);
+    color_lookup lookup(p, options);
+    grid g(width / scale, height / scale);
+
+    // Indexed images look up each palette entry once, the first time it is used
+    const int unresolved = INT32_MIN;
+    std::vector<int> index_to_symbol(png_palette.size(), unresolved);
+
+    auto sample = [&](const uint8_t* row, int x, int channel) -> int {
+        if (depth == 8)
+            return row[(size_t)x * channels + channel];
+        if (depth == 16)
+            return row[((size_t)x * channels + channel) * 2];
+        size_t bit = (size_t)x * depth;
+        return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+    };
+
+    auto convert_row = [&](const uint8_t* row, int y) {
+        for (int gx = 0; gx < g.width(); ++gx) {
+            int x = gx * scale;
+            int id;
+            if (color_type == 3) {
+                int index = sample(row, x, 0);
+                if (index >= (int)index_to_symbol.size())
+                    throw std::runtime_error("PNG palette index out of range");
+                if (index_to_symbol[index] == unresolved) {
+                    const color& c = png_palette[index];
+                    index_to_symbol[index] = lookup.find(c.r, c.g, c.b);
+                }
+                id = index_to_symbol[index];
+            }
+            else if (color_type == 0 || color_type == 4) {
+                int v = sample(row, x, 0);
+                if (depth < 8)
+                    v = v * 255 / ((1 << depth) - 1);
+                id = lookup.find((uint8_t)v, (uint8_t)v, (uint8_t)v);
+            }
+            else {
+                id = lookup.find((uint8_t)sample(row, x, 0), (uint8_t)sample(row, x, 1), (uint8_t)sample(row, x, 2));
+            }
+            g(gx, y / scale) = id;
+        }
+    };
+
+    // Feed the IDAT chunks to the decompressor one after another
+    uint32_t remaining = length;
+    bool done = false;
+    byte_source source = [&](uint8_t* buffer, size_t capacity) -> size_t {
+        while (remaining == 0 && !done) {
+            read_u32_be(in);    // CRC of the previous chunk
+            remaining = read_u32_be(in);
+            in.read(type, 4);
+            if (!in || std::strcmp(type, "IDAT") != 0)
+                done = true;
+        }
+        if (done)
+            return 0;
+        size_t n = std::min<size_t>(capacity, remaining);
+        in.read(reinterpret_cast<char*>(buffer), n);
+        if (!in)
+            throw std::runtime_error("Unexpected end of PNG file");
+        remaining -= (uint32_t)n;
+        return n;
+    };
+
+    // Only the current and the previous scanline are kept
+    std::vector<uint8_t> current(stride + 1), previous(stride + 1, 0);
+    size_t filled = 0;
+    int y = 0;
+    byte_sink sink = [&](const uint8_t* data, size_t size) {
+        while (size > 0 && y < height) {
+            size_t n = std::min(size, current.size() - filled);
+            std::memcpy(current.data() + filled, data, n);
+            filled += n;
+            data += n;
+            size -= n;
+
+            if (filled == current.size()) {
+                unfilter(current[0], current.data() + 1, previous.data() + 1, stride, bpp);
+                if (y % scale == 0 && y / scale < g.height())
+                    convert_row(current.data() + 1, y);
+                std::swap(current, previous);
+                filled = 0;
+                y++;
+            }
+        }
+    };
+
+    zlib_decompress(source, sink);
+    if (y < height)
+        throw std::runtime_error("PNG image data is truncated");
+    return g;
+}
+
+bool gs::load_image(const std::string& filename, grid& g, const palette& p, const image_import_options& options)
+{
+    try {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file for reading: " << filename << std::endl;
+            return false;
+        }
+
+        // PPM files start with 'P', PNG files with 0x89
+        if (file.peek() == 'P')
+            g = read_ppm(file, p, options);
+        else
+            g = read_png(file, p, options);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading image: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "grid_synth.hpp"
+#include "palette.hpp"
+#include "deflate.hpp"
+#include "batch.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            image export
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rendering of grids to images, one pixel (or scale x scale block of
+/// pixels) per cell, colored through a palette
+///
+/// PNG output is indexed when the grid uses at most 256 distinct symbols and
+/// true color otherwise. PPM output is always binary RGB (P6).
+
+/// @brief Image file formats
+enum class image_format
+{
+    ppm,
+    png
+};
+
+/// @brief Options for image export
+struct image_options
+{
+    int scale = 1;                                  ///< Pixels per cell along each axis
+    deflate_mode compression = deflate_mode::fixed; ///< PNG compression
+};
+
+/// @brief Guess the image format from a file name
+/// @param filename The file name
+/// @return image_format::ppm for .ppm files, image_format::png otherwise
+image_format image_format_from_filename(const std::string& filename);
+
+/// @brief Write a grid as a binary PPM image
+/// @param out The stream to write to
+/// @param g The grid
+/// @param p The palette
+/// @param options Export options
+void write_ppm(std::ostream& out, const grid& g, const palette& p, const image_options& options = {});
+
+/// @brief Write a grid as a PNG image
+/// @param out The stream to write to
+/// @param g The grid
+/// @param p The palette
+/// @param options Export options
+void write_png(std::ostream& out, const grid& g, const palette& p, const image_options& options = {});
+
+/// @brief Save a grid as an image, picking the format from the file name
+/// @param filename Path to the file
+/// @param g The grid
+/// @param p The palette
+/// @param options Export options
+/// @return True if save was successful, false otherwise
+bool save_image(const std::string& filename, const grid& g, const palette& p, const image_options& options = {});
+
+/// @brief Save many grids as images in parallel
+/// @param grids The grids
+/// @param filenames One path per grid
+/// @param p The palette
+/// @param options Export options
+/// @param threads Number of worker threads, 0 for one per hardware thread
+/// @return The number of images saved successfully
+size_t save_images(const std::vector<const grid*>& grids,
+                   const std::vector<std::string>& filenames,
+                   const palette& p,
+                   const image_options& options = {},
+                   int threads = 0);
+
+/// @brief Create a batch sink that saves every result as an image
+///
+/// Files are named after the seed, e.g. "<directory>/12345.png". Since batch
+/// sinks run on the worker threads, images are encoded in parallel.
+/// @param directory Directory to write to
+/// @param format The image format
+/// @param p The palette
+/// @param options Export options
+/// @return The sink
+batch_sink image_sink(const std::string& directory, image_format format,
+                      const palette& p, const image_options& options = {});
+
+////////////////////////////////////////////////////////////////////////////////
+////                            image import
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Conversion of palette images back to grids
+///
+/// Every pixel color is looked up in an exact-color hash table built from a
+/// palette, so images exported with the same palette round-trip. Images are
+/// decoded row by row straight into the grid; only a couple of scanlines are
+/// buffered besides the result. Supported are binary and ASCII PPM (P6, P3)
+/// and non-interlaced PNG of any color type.
+
+/// @brief Options for image import
+struct image_import_options
+{
+    int scale = 1;                                  ///< Pixels per cell, the top-left pixel of each block is used
+    int unknown_symbol = alphabet::empty_symbol.id; ///< Symbol for colors that are not in the palette
+    bool strict = false;                            ///< Fail on colors that are not in the palette
+};
+
+/// @brief Read a grid from a PPM image
+/// @param in The stream to read from
+/// @param p The palette mapping colors to symbols
+/// @param options Import options
+/// @return The grid
+/// @throws std::runtime_error if the image is invalid or, in strict mode, has unknown colors
+grid read_ppm(std::istream& in, const palette& p, const image_import_options& options = {});
+
+/// @brief Read a grid from a PNG image
+/// @param in The stream to read from
+/// @param p The palette mapping colors to symbols
+/// @param options Import options
+/// @return The grid
+/// @throws std::runtime_error if the image is invalid or, in strict mode, has unknown colors
+grid read_png(std::istream& in, const palette& p, const image_import_options& options = {});
+
+/// @brief Load a grid from an image, picking the format from the file contents
+/// @param filename Path to the file
+/// @param g The grid to load into
+/// @param p The palette mapping colors to symbols
+/// @param options Import options
+/// @return True if load was successful, false otherwise
+bool load_image(const std::string& filename, grid& g, const palette& p, const image_import_options& options = {});
+
+}
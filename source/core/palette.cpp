@@ -0,0 +1,94 @@
+#include <cmath>
+#include <unordered_set>
+#include "palette.hpp"
+
+using namespace gs;
+
+namespace
+{
+    uint8_t to_byte(float v)
+    {
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        return (uint8_t)(int)(v * 255.0f + 0.5f);
+    }
+
+    /// Same conversion as ImGui::ColorConvertHSVtoRGB, so exported images
+    /// match what the editor shows
+    color hsv_to_rgb(float h, float s, float v)
+    {
+        float r, g, b;
+        h = std::fmod(h, 1.0f) / (60.0f / 360.0f);
+        int i = (int)h;
+        float f = h - (float)i;
+        float p = v * (1.0f - s);
+        float q = v * (1.0f - s * f);
+        float t = v * (1.0f - s * (1.0f - f));
+
+        switch (i) {
+            case 0: r = v; g = t; b = p; break;
+            case 1: r = q; g = v; b = p; break;
+            case 2: r = p; g = v; b = t; break;
+            case 3: r = p; g = q; b = v; break;
+            case 4: r = t; g = p; b = v; break;
+            case 5: default: r = v; g = p; b = q; break;
+        }
+        return {to_byte(r), to_byte(g), to_byte(b), 255};
+    }
+}
+
+color gs::nice_color(int id)
+{
+    static double golden_ratio_conjugate = 0.618033988749895;
+    float hue = (float)std::fmod(id * golden_ratio_conjugate, 1.0);
+    return hsv_to_rgb(hue, 0.8f, 0.6f);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                                palette
+////////////////////////////////////////////////////////////////////////////////
+
+palette palette::from_alphabet(const alphabet& a)
+{
+    // With a few hundred symbols the nice colors repeat, and an import would
+    // merge the symbols sharing one. Repeats are moved to the nearest free
+    // color, flipping low bits so they look the same as in the editor.
+    std::unordered_set<uint32_t> used;
+    auto pack = [](const color& c) { return ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b; };
+    palette p;
+    auto add = [&](int id) {
+        const uint32_t base = pack(nice_color(id));
+        uint32_t rgb = base;
+        for (uint32_t k = 1; !used.insert(rgb).second; ++k)
+            rgb = base ^ (((k & 0x7) << 16) | ((k >> 3 & 0x7) << 8) | (k >> 6));
+        p.set(id, {(uint8_t)(rgb >> 16), (uint8_t)(rgb >> 8), (uint8_t)rgb, 255});
+    };
+    add(alphabet::wildcard_symbol.id);
+    add(alphabet::empty_symbol.id);
+    for (const auto& s : a.get_symbols())
+        add(s.id);
+    return p;
+}
+
+void palette::set(int id, color c)
+{
+    auto it = m_index.find(id);
+    if (it != m_index.end()) {
+        m_colors[it->second] = c;
+        return;
+    }
+    m_index[id] = (int)m_ids.size();
+    m_ids.push_back(id);
+    m_colors.push_back(c);
+}
+
+color palette::get(int id) const
+{
+    auto it = m_index.find(id);
+    return it != m_index.end() ? m_colors[it->second] : nice_color(id);
+}
+
+int palette::index_of(int id) const
+{
+    auto it = m_index.find(id);
+    return it != m_index.end() ? it->second : -1;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                                color
+////////////////////////////////////////////////////////////////////////////////
+/// @brief An 8-bit per channel RGBA color
+struct color
+{
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = 255;
+
+    bool operator==(const color& o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
+    bool operator!=(const color& o) const { return !(*this == o); }
+};
+
+/// @brief Default color of a symbol
+///
+/// Spreads hues with the golden ratio so neighbouring IDs get distinct
+/// colors. This is the color the editor draws symbols with.
+/// @param id The symbol ID
+/// @return The color
+color nice_color(int id);
+
+////////////////////////////////////////////////////////////////////////////////
+////                                palette
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Maps symbol IDs to colors and to indices of an indexed image
+///
+/// Symbols without an explicit color use nice_color(). Indices are assigned
+/// in the order entries are added, which for from_alphabet() is the wildcard,
+/// the empty symbol and then the alphabet ordered by ID. The colors of
+/// from_alphabet() are all distinct, so images map back to the same symbols.
+class palette
+{
+public:
+    /// @brief Constructor, creates an empty palette
+    palette() = default;
+
+    /// @brief Create a palette with an entry for every symbol of an alphabet
+    /// @param a The alphabet
+    /// @return The palette
+    static palette from_alphabet(const alphabet& a);
+
+    /// @brief Set the color of a symbol, adding an entry if needed
+    /// @param id The symbol ID
+    /// @param c The color
+    void set(int id, color c);
+
+    /// @brief Get the color of a symbol
+    /// @param id The symbol ID
+    /// @return The color of the entry, or nice_color() if there is none
+    color get(int id) const;
+
+    /// @brief Get the index of a symbol
+    /// @param id The symbol ID
+    /// @return The index of the entry, or -1 if there is none
+    int index_of(int id) const;
+
+    /// @brief Get the symbol ID of an index
+    /// @param index The index
+    /// @return The symbol ID
+    int id_at(int index) const { return m_ids[index]; }
+
+    /// @brief Get the color of an index
+    /// @param index The index
+    /// @return The color
+    color color_at(int index) const { return m_colors[index]; }
+
+    /// @brief Get the number of entries
+    /// @return The number of entries
+    int size() const { return (int)m_ids.size(); }
+
+private:
+    std::vector<int> m_ids;
+    std::vector<color> m_colors;
+    std::unordered_map<int, int> m_index;
+};
+
+}
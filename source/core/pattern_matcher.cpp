@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "pattern_matcher.hpp"
+
+using namespace gs;
+
+pattern_matcher::pattern_matcher(const grid& pattern)
+    : m_width(pattern.width()), m_height(pattern.height())
+{
+    for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x) {
+            if (pattern(x, y) != alphabet::wildcard_symbol.id)
+                m_cells.push_back({x, y, pattern(x, y)});
+        }
+    }
+}
+
+bool pattern_matcher::matches(const grid& g, int x, int y) const
+{
+    if (x < 0 || y < 0 || x + m_width > g.width() || y + m_height > g.height())
+        return false;
+
+    const int* base = g.raw_data() + (size_t)y * g.width() + x;
+    for (const auto& c : m_cells) {
+        if (base[c.dy * g.width() + c.dx] != c.value)
+            return false;
+    }
+    return true;
+}
+
+size_t pattern_matcher::find(const grid& g, grid& mask, int x0, int y0, int x1, int y1) const
+{
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(g.width() - 1, x1);
+    y1 = std::min(g.height() - 1, y1);
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    // Offsets of the pattern cells for this grid width
+    const int w = g.width();
+    std::vector<ptrdiff_t> offsets;
+    std::vector<int> values;
+    offsets.reserve(m_cells.size());
+    values.reserve(m_cells.size());
+    for (const auto& c : m_cells) {
+        offsets.push_back((ptrdiff_t)c.dy * w + c.dx);
+        values.push_back(c.value);
+    }
+    const size_t n = offsets.size();
+
+    // Last position where the pattern still fits
+    const int fit_x = g.width() - m_width;
+    const int fit_y = g.height() - m_height;
+
+    const int* data = g.raw_data();
+    int* out = mask.raw_data();
+    size_t count = 0;
+    for (int y = y0; y <= y1; ++y) {
+        int* row = out + (size_t)y * w;
+        if (y > fit_y) {
+            std::fill(row + x0, row + x1 + 1, 0);
+            continue;
+        }
+
+        const int end = std::min(x1, fit_x);
+        const int* base = data + (size_t)y * w;
+        for (int x = x0; x <= end; ++x) {
+            const int* p = base + x;
+            size_t i = 0;
+            while (i < n && p[offsets[i]] == values[i])
+                ++i;
+            const int hit = i == n;
+            row[x] = hit;
+            count += hit;
+        }
+        if (end < x1)
+            std::fill(row + std::max(x0, end + 1), row + x1 + 1, 0);
+    }
+    return count;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                           pattern_matcher
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Search pattern compiled for fast matching
+///
+/// Wildcard cells are dropped when the pattern is compiled, the remaining
+/// cells are checked through raw offsets into the grid data, so testing a
+/// position does no bounds checks and skips wildcards for free. A position
+/// is the top-left cell of the pattern; positions where the pattern does not
+/// fit never match.
+class pattern_matcher
+{
+public:
+    /// @brief Compile a search pattern
+    /// @param pattern The pattern, wildcard cells match anything
+    explicit pattern_matcher(const grid& pattern);
+
+    /// @brief Get the width of the pattern
+    int width() const { return m_width; }
+
+    /// @brief Get the height of the pattern
+    int height() const { return m_height; }
+
+    /// @brief Test one position
+    /// @param g The grid
+    /// @param x Column of the top-left cell of the pattern
+    /// @param y Row of the top-left cell of the pattern
+    /// @return True if the pattern fits and matches there
+    bool matches(const grid& g, int x, int y) const;
+
+    /// @brief Test every position in a region and record the result
+    /// @param g The grid
+    /// @param mask Receives 1 at matching positions and 0 elsewhere, must
+    ///        have the size of the grid
+    /// @param x0 Left column of the region
+    /// @param y0 Top row of the region
+    /// @param x1 Right column of the region, inclusive
+    /// @param y1 Bottom row of the region, inclusive
+    /// @return The number of matching positions in the region
+    size_t find(const grid& g, grid& mask, int x0, int y0, int x1, int y1) const;
+
+private:
+    struct cell {
+        int dx;
+        int dy;
+        int value;
+    };
+
+    int m_width;
+    int m_height;
+    std::vector<cell> m_cells;      ///< Non-wildcard cells of the pattern
+};
+
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "result_cache.hpp"
+#include "grid_io.hpp"
+#include "hash.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace gs;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Numbers the temporary files of this process
+    std::atomic<uint64_t> temp_counter{0};
+
+    long process_id()
+    {
+#ifdef _WIN32
+        return (long)_getpid();
+#else
+        return (long)getpid();
+#endif
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            result_cache
+////////////////////////////////////////////////////////////////////////////////
+
+result_cache::result_cache(std::string directory, uint64_t max_bytes)
+    : m_directory(std::move(directory)), m_max_bytes(max_bytes)
+{
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec)
+        std::cerr << "Could not create cache directory: " << m_directory << std::endl;
+
+    // Force a directory scan on the first store
+    m_known_bytes = UINT64_MAX;
+}
+
+std::string result_cache::default_directory()
+{
+    if (const char* dir = std::getenv("GRID_SYNTH_CACHE_DIR"))
+        return dir;
+
+    std::error_code ec;
+    fs::path tmp = fs::temp_directory_path(ec);
+    if (ec)
+        tmp = ".";
+    return (tmp / "grid_synth_cache").string();
+}
+
+uint64_t result_cache::key(const grid_synth& synth)
+{
+    // nlohmann::json keeps object keys sorted, so the dump is canonical
+    const grid& input = synth.get_grid();
+    uint64_t h = hash_combine(0, (uint64_t)engine_version);
+    h = hash_string(synth.pipeline_to_json().dump(), h);
+    h = hash_combine(h, (uint64_t)input.width());
+    h = hash_combine(h, (uint64_t)input.height());
+    h = hash_bytes(input.raw_data(), (size_t)input.width() * input.height() * sizeof(int), h);
+    return h;
+}
+
+std::string result_cache::entry_path(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.gsg", (unsigned long long)key);
+    return (fs::path(m_directory) / name).string();
+}
+
+bool result_cache::load(uint64_t key, grid& output)
+{
+    std::string path = entry_path(key);
+    std::error_code ec;
+    if (!fs::exists(path, ec) || !load_grid_binary(path, output)) {
+        m_misses++;
+        return false;
+    }
+
+    // Touch the entry so it counts as recently used
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    m_hits++;
+    return true;
+}
+
+void result_cache::store(uint64_t key, const grid& result)
+{
+    // Write to a temporary file first so readers never see a partial entry.
+    // The directory is shared with other processes, the name has to be
+    // unique across them. The file I/O runs unlocked so threads storing
+    // different entries don't wait for each other.
+    std::string path = entry_path(key);
+    std::string tmp_path = path + "." + std::to_string(process_id()) + "." +
+                           std::to_string(temp_counter++) + ".tmp";
+    if (!save_grid_binary(tmp_path, result))
+        return;
+
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+        std::cerr << "Could not store cache entry: " << path << std::endl;
+        fs::remove(tmp_path, ec);
+        return;
+    }
+
+    // Only rescan the directory once the running total says we may be over
+    uint64_t size = (uint64_t)fs::file_size(path, ec);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_known_bytes != UINT64_MAX)
+            m_known_bytes += size;
+        if (m_known_bytes <= m_max_bytes || m_evicting)
+            return;
+        m_evicting = true;
+    }
+    evict();
+}
+
+void result_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(m_directory, ec)) {
+        if (entry.path().extension() == ".gsg")
+            fs::remove(entry.path(), ec);
+    }
+    m_known_bytes = 0;
+}
+
+void result_cache::evict()
+{
+    struct entry_info {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+
+    std::error_code ec;
+    std::vector<entry_info> entries;
+    uint64_t total = 0;
+    for (const auto& entry : fs::directory_iterator(m_directory, ec)) {
+        if (entry.path().extension() != ".gsg")
+            continue;
+        entry_info info{entry.path(), entry.last_write_time(ec), (uint64_t)entry.file_size(ec)};
+        total += info.size;
+        entries.push_back(std::move(info));
+    }
+
+    if (total > m_max_bytes) {
+        // Oldest first
+        std::sort(entries.begin(), entries.end(), [](const entry_info& a, const entry_info& b) {
+            return a.time < b.time;
+        });
+
+        for (const auto& e : entries) {
+            if (total <= m_max_bytes)
+                break;
+            if (fs::remove(e.path, ec))
+                total -= e.size;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_known_bytes = total;
+    m_evicting = false;
+}
+
+bool gs::synthesize_cached(grid_synth& synth, result_cache& cache, const synthesis_control& control)
+{
+    uint64_t key = result_cache::key(synth);
+    if (cache.load(key, synth.get_grid()))
+        return true;
+
+    if (synth.synthesize(control))
+        cache.store(key, synth.get_grid());
+    return false;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            result_cache
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Content-addressed on-disk cache of synthesized grids
+///
+/// Entries are keyed by a hash of the canonical pipeline JSON, the seed, the
+/// input grid and the engine version, and stored one file per entry in the
+/// binary grid format. The total size of the cache directory is bounded;
+/// when it grows past the limit the least recently used entries are removed.
+/// Recency is tracked through file modification times, so several processes
+/// can share one cache directory.
+class result_cache
+{
+public:
+    /// @brief Constructor
+    /// @param directory Directory holding the cache entries, created if missing
+    /// @param max_bytes Upper bound on the total size of all entries
+    explicit result_cache(std::string directory, uint64_t max_bytes = 512ull * 1024 * 1024);
+
+    /// @brief Destructor
+    ~result_cache() = default;
+
+    /// @brief Default cache directory
+    ///
+    /// Uses the GRID_SYNTH_CACHE_DIR environment variable when set, otherwise
+    /// a grid_synth_cache folder in the system temporary directory.
+    /// @return Path to the directory
+    static std::string default_directory();
+
+    /// @brief Compute the cache key for the current state of a synthesizer
+    /// @param synth The synthesizer, with its input grid
+    /// @return The key identifying the result of synthesize()
+    static uint64_t key(const grid_synth& synth);
+
+    /// @brief Look up an entry
+    /// @param key The key of the entry
+    /// @param output The grid to load the entry into
+    /// @return True on a cache hit, false otherwise
+    bool load(uint64_t key, grid& output);
+
+    /// @brief Store an entry, evicting old entries if needed
+    /// @param key The key of the entry
+    /// @param result The synthesized grid
+    void store(uint64_t key, const grid& result);
+
+    /// @brief Remove all entries
+    void clear();
+
+    /// @brief Get the cache directory
+    /// @return Path to the directory
+    const std::string& directory() const { return m_directory; }
+
+    /// @brief Get the size limit
+    /// @return Upper bound on the total size of all entries in bytes
+    uint64_t max_bytes() const { return m_max_bytes; }
+
+    /// @brief Set the size limit
+    /// @param max_bytes Upper bound on the total size of all entries in bytes
+    void set_max_bytes(uint64_t max_bytes) { m_max_bytes = max_bytes; }
+
+    /// @brief Get the number of hits since construction
+    /// @return The number of hits
+    uint64_t hits() const { return m_hits; }
+
+    /// @brief Get the number of misses since construction
+    /// @return The number of misses
+    uint64_t misses() const { return m_misses; }
+
+private:
+    /// @brief Get the path of the file for an entry
+    std::string entry_path(uint64_t key) const;
+
+    /// @brief Remove least recently used entries until under the size limit,
+    /// called by one store at a time without holding m_mutex
+    void evict();
+
+    std::string m_directory;
+    uint64_t m_max_bytes;
+    uint64_t m_known_bytes = 0;   ///< Size of the directory as of the last scan, plus stores since, guarded by m_mutex
+    bool m_evicting = false;      ///< Whether a store is scanning the directory, guarded by m_mutex
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::mutex m_mutex;
+};
+
+/// @brief Synthesize, reusing a cached result when one exists
+///
+/// On a hit the grid of the synthesizer is replaced by the cached result and
+/// no transformation runs. On a miss the pipeline runs and the result is
+/// stored in the cache.
+/// @param synth The synthesizer
+/// @param cache The cache to consult
+/// @param control Optional progress callback and cancellation flag, a
+///        cancelled result is not stored
+/// @return True on a cache hit, false if the pipeline had to run
+bool synthesize_cached(grid_synth& synth, result_cache& cache, const synthesis_control& control = {});
+
+}
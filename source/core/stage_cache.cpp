@@ -0,0 +1,67 @@
+#include "stage_cache.hpp"
+
+using namespace gs;
+
+namespace
+{
+    size_t grid_bytes(const grid& g)
+    {
+        return (size_t)g.width() * g.height() * sizeof(int);
+    }
+}
+
+stage_cache::stage_cache(size_t max_bytes)
+    : m_max_bytes(max_bytes)
+{
+}
+
+bool stage_cache::find(uint64_t key, grid& g)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+        return false;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    g = it->second->output;
+    return true;
+}
+
+void stage_cache::store(uint64_t key, const grid& g)
+{
+    const size_t size = grid_bytes(g);
+    if (size > m_max_bytes)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    m_entries.push_front({key, g});
+    m_index[key] = m_entries.begin();
+    m_bytes += size;
+
+    while (m_bytes > m_max_bytes) {
+        const entry& oldest = m_entries.back();
+        m_bytes -= grid_bytes(oldest.output);
+        m_index.erase(oldest.key);
+        m_entries.pop_back();
+    }
+}
+
+void stage_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+size_t stage_cache::bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
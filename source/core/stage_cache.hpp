@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            stage_cache
+////////////////////////////////////////////////////////////////////////////////
+/// @brief In-memory cache of intermediate stage outputs
+///
+/// Keys come from grid_synth::stage_keys(), a hash chain over the input grid
+/// and every stage up to and including the cached one. When a pipeline is
+/// edited, the outputs of the unchanged prefix of the stack are still found
+/// and synthesis resumes from the first changed stage. The least recently
+/// used outputs are dropped once the total size exceeds the limit.
+class stage_cache
+{
+public:
+    /// @brief Constructor
+    /// @param max_bytes Maximum total size of the cached grids
+    explicit stage_cache(size_t max_bytes = 256ull * 1024 * 1024);
+
+    /// @brief Look up a stage output
+    /// @param key The stage key
+    /// @param g Receives a copy of the output on a hit
+    /// @return True on a hit
+    bool find(uint64_t key, grid& g);
+
+    /// @brief Store a stage output
+    /// @param key The stage key
+    /// @param g The output
+    void store(uint64_t key, const grid& g);
+
+    /// @brief Remove all entries
+    void clear();
+
+    /// @brief Get the total size of the cached grids
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    struct entry {
+        uint64_t key;
+        grid output;
+    };
+
+    std::list<entry> m_entries;     ///< Most recently used first
+    std::unordered_map<uint64_t, std::list<entry>::iterator> m_index;
+    size_t m_bytes = 0;
+    size_t m_max_bytes;
+    mutable std::mutex m_mutex;
+};
+
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include "synthesis_pool.hpp"
+
+using namespace gs;
+
+synthesis_pool::synthesis_pool(int threads, int background_threads)
+{
+    if (threads <= 0)
+        threads = (int)std::max(2u, std::thread::hardware_concurrency()) - 1;
+    if (background_threads <= 0)
+        background_threads = std::max(1, threads / 2);
+    m_background_limit = std::min(background_threads, threads);
+
+    m_workers = std::make_unique<worker[]>(threads);
+    for (int i = 0; i < threads; ++i)
+        m_threads.emplace_back([this, i]() { run((size_t)i); });
+}
+
+synthesis_pool::~synthesis_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        m_queue.clear();
+        for (size_t i = 0; i < m_threads.size(); ++i)
+            m_workers[i].preempt = true;
+    }
+    m_changed.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void synthesis_pool::submit(const void* owner, task fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back({owner, std::move(fn)});
+        if (owner == m_foreground)
+            make_room();
+    }
+    m_changed.notify_all();
+}
+
+void synthesis_pool::cancel(const void* owner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+                                 [owner](const entry& e) { return e.owner == owner; }),
+                  m_queue.end());
+
+    // Tasks stopped by the flag would queue themselves again without this
+    m_cancelling.push_back(owner);
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        if (m_workers[i].owner == owner)
+            m_workers[i].preempt = true;
+    m_changed.wait(lock, [&]() { return !pending(owner); });
+    m_cancelling.erase(std::find(m_cancelling.begin(), m_cancelling.end(), owner));
+}
+
+void synthesis_pool::wait(const void* owner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [&]() { return !pending(owner); });
+}
+
+bool synthesis_pool::pending(const void* owner) const
+{
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        if (m_workers[i].owner == owner)
+            return true;
+    return std::any_of(m_queue.begin(), m_queue.end(), [owner](const entry& e) { return e.owner == owner; });
+}
+
+void synthesis_pool::set_foreground(const void* owner)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_foreground = owner;
+        make_room();
+    }
+    m_changed.notify_all();
+}
+
+bool synthesis_pool::take(entry& e)
+{
+    if (m_queue.empty())
+        return false;
+
+    // Foreground tasks first, whatever the budget
+    auto it = m_queue.end();
+    if (m_foreground)
+        it = std::find_if(m_queue.begin(), m_queue.end(),
+                          [this](const entry& q) { return q.owner == m_foreground; });
+
+    if (it == m_queue.end()) {
+        int background = 0;
+        for (size_t i = 0; i < m_threads.size(); ++i)
+            if (m_workers[i].owner && m_workers[i].owner != m_foreground)
+                background++;
+        if (background >= m_background_limit)
+            return false;
+        it = m_queue.begin();
+    }
+
+    e = std::move(*it);
+    m_queue.erase(it);
+    return true;
+}
+
+void synthesis_pool::make_room()
+{
+    if (!m_foreground)
+        return;
+
+    size_t waiting = (size_t)std::count_if(m_queue.begin(), m_queue.end(),
+                                           [this](const entry& q) { return q.owner == m_foreground; });
+
+    // Idle threads and background tasks already told to stop will be free soon
+    size_t room = 0;
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        const worker& w = m_workers[i];
+        if (!w.owner || (w.owner != m_foreground && w.preempt))
+            room++;
+    }
+
+    for (size_t i = 0; i < m_threads.size() && room < waiting; ++i) {
+        worker& w = m_workers[i];
+        if (w.owner && w.owner != m_foreground && !w.preempt) {
+            w.preempt = true;
+            room++;
+        }
+    }
+}
+
+void synthesis_pool::run(size_t index)
+{
+    worker& w = m_workers[index];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        entry e;
+        m_changed.wait(lock, [&]() { return m_quit || take(e); });
+        if (m_quit)
+            return;
+
+        w.owner = e.owner;
+        w.preempt = false;
+        lock.unlock();
+        const bool finished = e.fn(w.preempt);
+        lock.lock();
+        w.owner = nullptr;
+        w.preempt = false;
+
+        // A preempted task goes before the newer tasks of its owner
+        const bool cancelled = std::find(m_cancelling.begin(), m_cancelling.end(), e.owner) != m_cancelling.end();
+        if (!finished && !cancelled && !m_quit)
+            m_queue.push_front(std::move(e));
+
+        // Wakes cancel() and the threads waiting for a background slot
+        m_changed.notify_all();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                          synthesis_pool
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Thread pool shared by the open documents
+///
+/// Tasks are queued under an owner, any pointer identifying who submitted
+/// them. Tasks of the foreground owner run first. The other owners share a
+/// budget of threads, so background work never takes the whole pool. When
+/// foreground work is waiting and no thread is free, running background
+/// tasks are asked to stop through their preempt flag. A task that stops
+/// early is queued again in front of newer work and runs again later. Tasks
+/// that store their stages in a stage_cache resume where they stopped.
+class synthesis_pool
+{
+public:
+    /// @brief Task to run, receives a flag set when it should stop early
+    /// @return False if it stopped early because of the flag and has to run again
+    using task = std::function<bool(const std::atomic<bool>& preempt)>;
+
+    /// @brief Constructor, starts the threads
+    /// @param threads Number of threads, 0 for all cores but one, left for
+    ///        the UI and the synthesis of the focused document
+    /// @param background_threads Most threads running background tasks at
+    ///        once, 0 for half of the threads
+    explicit synthesis_pool(int threads = 0, int background_threads = 0);
+
+    /// @brief Destructor, drops the queued tasks, preempts the running ones
+    /// and joins the threads
+    ~synthesis_pool();
+
+    synthesis_pool(const synthesis_pool&) = delete;
+    synthesis_pool& operator=(const synthesis_pool&) = delete;
+
+    /// @brief Queue a task
+    /// @param owner Owner of the task, not null
+    /// @param fn The task, run on a pool thread
+    void submit(const void* owner, task fn);
+
+    /// @brief Drop the queued tasks of an owner and wait for its running ones
+    /// to stop, must not be called from one of its tasks
+    /// @param owner The owner
+    void cancel(const void* owner);
+
+    /// @brief Wait until the queued and running tasks of an owner are done,
+    /// must not be called from one of its tasks
+    /// @param owner The owner
+    void wait(const void* owner);
+
+    /// @brief Give an owner priority over all others, preempting background
+    /// tasks if its queued tasks have no free thread
+    /// @param owner The owner, null for none
+    void set_foreground(const void* owner);
+
+    /// @brief Get the number of threads
+    int threads() const { return (int)m_threads.size(); }
+
+    /// @brief Get the most threads running background tasks at once
+    int background_threads() const { return m_background_limit; }
+
+private:
+    struct entry {
+        const void* owner;
+        task fn;
+    };
+
+    struct worker {
+        const void* owner = nullptr;    ///< Owner of the running task, null when idle
+        std::atomic<bool> preempt{false};
+    };
+
+    void run(size_t index);
+
+    /// @brief Take the next task a free thread may run, m_mutex must be held
+    bool take(entry& e);
+
+    /// @brief Check if an owner has queued or running tasks, m_mutex must be held
+    bool pending(const void* owner) const;
+
+    /// @brief Preempt background tasks until the queued foreground tasks
+    /// have threads, m_mutex must be held
+    void make_room();
+
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<worker[]> m_workers;
+    int m_background_limit;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<entry> m_queue;                  ///< Guarded by m_mutex
+    std::vector<const void*> m_cancelling;      ///< Guarded by m_mutex
+    const void* m_foreground = nullptr;         ///< Guarded by m_mutex
+    bool m_quit = false;                        ///< Guarded by m_mutex
+};
+
+}
@@ -0,0 +1,123 @@
+#include "synthesis_timeline.hpp"
+#include "grid_io.hpp"
+
+using namespace gs;
+
+synthesis_timeline::synthesis_timeline(size_t max_bytes, int keyframe_interval)
+    : m_max_bytes(max_bytes), m_keyframe_interval(keyframe_interval)
+{
+}
+
+void synthesis_timeline::clear()
+{
+    m_frames.clear();
+    m_last = grid(0, 0);
+    m_since_keyframe = 0;
+    m_cursor = grid(0, 0);
+    m_cursor_frame = SIZE_MAX;
+    m_bytes = 0;
+    m_dropped = 0;
+}
+
+size_t synthesis_timeline::frame_bytes(const frame& f)
+{
+    return sizeof(frame) + f.label.capacity() + f.keyframe.capacity() + f.diff.bytes();
+}
+
+void synthesis_timeline::append(size_t stage, std::string label, const grid& g)
+{
+    frame f{stage, std::move(label), {}, grid_diff()};
+
+    // A diff unless it would be larger than the whole grid, which is common
+    // for stages that rewrite most cells
+    bool key = m_frames.empty() || m_since_keyframe + 1 >= m_keyframe_interval;
+    if (!key) {
+        f.diff = grid_diff::between(m_last, g);
+        std::vector<uint8_t> compressed = compress_grid(g);
+        if (compressed.size() < f.diff.bytes()) {
+            f.diff = grid_diff();
+            f.keyframe = std::move(compressed);
+            key = true;
+        }
+    } else {
+        f.keyframe = compress_grid(g);
+    }
+    m_since_keyframe = key ? 0 : m_since_keyframe + 1;
+
+    m_bytes += frame_bytes(f);
+    m_frames.push_back(std::move(f));
+    m_last = g;
+}
+
+void synthesis_timeline::record(size_t stage, std::string label, const grid& g)
+{
+    append(stage, std::move(label), g);
+    while (m_bytes > m_max_bytes && m_frames.size() > 2)
+        thin();
+}
+
+void synthesis_timeline::thin()
+{
+    std::vector<frame> old;
+    std::swap(old, m_frames);
+    m_bytes = 0;
+    m_since_keyframe = 0;
+    m_cursor_frame = SIZE_MAX;
+
+    // Replay the old frames and record every other one again
+    grid current(0, 0);
+    for (size_t i = 0; i < old.size(); ++i) {
+        frame& f = old[i];
+        if (!f.keyframe.empty())
+            current = decompress_grid(f.keyframe.data(), f.keyframe.size());
+        else
+            f.diff.apply(current, true);
+
+        if (i % 2 == 0 || i + 1 == old.size())
+            append(f.stage, std::move(f.label), current);
+        else
+            m_dropped++;
+    }
+}
+
+const grid& synthesis_timeline::seek(size_t target)
+{
+    if (target >= m_frames.size() || target == m_cursor_frame)
+        return m_cursor;
+
+    // Nearest keyframe at or before the target
+    size_t key = target;
+    while (m_frames[key].keyframe.empty())
+        key--;
+    size_t cost = target - key;
+
+    // Stepping from the current frame may be cheaper, backwards only
+    // while no keyframe has to be undone
+    bool from_cursor = false;
+    if (m_cursor_frame != SIZE_MAX) {
+        if (target > m_cursor_frame && target - m_cursor_frame <= cost) {
+            from_cursor = true;
+        } else if (target < m_cursor_frame && m_cursor_frame - target <= cost) {
+            from_cursor = true;
+            for (size_t i = target + 1; i <= m_cursor_frame; ++i)
+                if (!m_frames[i].keyframe.empty())
+                    from_cursor = false;
+        }
+    }
+
+    if (from_cursor && target < m_cursor_frame) {
+        for (size_t i = m_cursor_frame; i > target; --i)
+            m_frames[i].diff.apply(m_cursor, false);
+    } else {
+        size_t first = from_cursor ? m_cursor_frame + 1 : key;
+        for (size_t i = first; i <= target; ++i) {
+            const frame& f = m_frames[i];
+            if (!f.keyframe.empty())
+                m_cursor = decompress_grid(f.keyframe.data(), f.keyframe.size());
+            else
+                f.diff.apply(m_cursor, true);
+        }
+    }
+    m_cursor_frame = target;
+    return m_cursor;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "grid_synth.hpp"
+#include "grid_diff.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                         synthesis_timeline
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Recording of the intermediate grids of a synthesis
+///
+/// Frame 0 is the input grid, each following frame the output of a stage.
+/// Frames are stored as keyframes (compressed whole grids) or as diffs to the
+/// previous frame, whichever is smaller, with a keyframe at least every few
+/// frames so seeking never replays a long chain. Seeking to a neighbouring
+/// frame applies a single diff, forwards or backwards.
+///
+/// When the recording exceeds its memory budget, every other frame is
+/// dropped (the first and last are always kept) until it fits again.
+class synthesis_timeline
+{
+public:
+    /// @brief Constructor
+    /// @param max_bytes Memory budget of the recorded frames
+    /// @param keyframe_interval Largest number of frames between keyframes
+    explicit synthesis_timeline(size_t max_bytes = 128ull * 1024 * 1024, int keyframe_interval = 8);
+
+    /// @brief Remove all frames
+    void clear();
+
+    /// @brief Append a frame
+    /// @param stage Position of the stage in the pipeline, ignored for the input
+    /// @param label Description shown in the UI
+    /// @param g The grid
+    void record(size_t stage, std::string label, const grid& g);
+
+    /// @brief Get the number of frames
+    size_t size() const { return m_frames.size(); }
+
+    /// @brief Get the label of a frame
+    const std::string& label(size_t frame) const { return m_frames[frame].label; }
+
+    /// @brief Get the pipeline position of the stage that produced a frame
+    size_t stage(size_t frame) const { return m_frames[frame].stage; }
+
+    /// @brief Reconstruct a frame
+    /// @param frame The frame
+    /// @return The grid of the frame, valid until the next call
+    const grid& seek(size_t frame);
+
+    /// @brief Get the memory used by the frames
+    /// @return Size in bytes
+    size_t bytes() const { return m_bytes; }
+
+    /// @brief Get the number of frames dropped to stay in budget
+    size_t dropped() const { return m_dropped; }
+
+private:
+    struct frame {
+        size_t stage;
+        std::string label;
+        std::vector<uint8_t> keyframe;  ///< Compressed grid, empty for diff frames
+        grid_diff diff;                 ///< Change from the previous frame
+    };
+
+    static size_t frame_bytes(const frame& f);
+    void append(size_t stage, std::string label, const grid& g);
+    void thin();
+
+    std::vector<frame> m_frames;
+    grid m_last{0, 0};                  ///< Grid of the last frame, to diff the next one against
+    int m_since_keyframe = 0;           ///< Frames since the last keyframe
+
+    grid m_cursor{0, 0};                ///< Grid of the frame last sought
+    size_t m_cursor_frame = SIZE_MAX;   ///< Frame held in m_cursor, SIZE_MAX if none
+
+    size_t m_bytes = 0;
+    size_t m_max_bytes;
+    int m_keyframe_interval;
+    size_t m_dropped = 0;
+};
+
+}
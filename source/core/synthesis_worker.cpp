@@ -0,0 +1,119 @@
+#include <chrono>
+#include "synthesis_worker.hpp"
+#include "result_cache.hpp"
+
+using namespace gs;
+
+synthesis_worker::synthesis_worker()
+{
+    m_thread = std::thread([this]() { run(); });
+}
+
+synthesis_worker::~synthesis_worker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        m_cancel = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void synthesis_worker::start(grid_synth job, result_cache* cache, stage_cache* stages)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = std::make_unique<grid_synth>(std::move(job));
+        m_pending_cache = cache;
+        m_pending_stages = stages;
+        m_cancel = true;
+        m_busy = true;
+    }
+    m_condition.notify_one();
+}
+
+void synthesis_worker::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.reset();
+    m_cancel = true;
+    m_busy = m_running;
+}
+
+bool synthesis_worker::take_result(batch_result& result,
+                                   std::vector<stage_profile>* profile,
+                                   std::vector<stage_thumbnail>* thumbnails,
+                                   synthesis_timeline* timeline)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_has_result)
+        return false;
+    std::swap(result, m_front);
+    if (profile)
+        std::swap(*profile, m_front_profile);
+    if (thumbnails)
+        std::swap(*thumbnails, m_front_thumbnails);
+    if (timeline)
+        std::swap(*timeline, m_front_timeline);
+    m_has_result = false;
+    return true;
+}
+
+void synthesis_worker::run()
+{
+    for (;;) {
+        std::unique_ptr<grid_synth> job;
+        result_cache* cache = nullptr;
+        stage_cache* stages = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_quit || m_pending; });
+            if (m_quit)
+                return;
+            job = std::move(m_pending);
+            cache = m_pending_cache;
+            stages = m_pending_stages;
+            m_cancel = false;
+            m_running = true;
+            m_progress = 0.0f;
+        }
+
+        std::vector<stage_profile> profile;
+        std::vector<stage_thumbnail> thumbnails;
+        synthesis_control control;
+        control.cancel = &m_cancel;
+        control.stages = stages;
+        control.profile = &profile;
+        control.thumbnail_size = m_thumbnail_size;
+        if (control.thumbnail_size > 0)
+            control.thumbnails = &thumbnails;
+        synthesis_timeline timeline(m_timeline_budget);
+        if (m_timeline_budget > 0)
+            control.timeline = &timeline;
+        control.progress = [this](size_t done, size_t total) {
+            m_progress = total > 0 ? (float)done / (float)total : 1.0f;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        bool hit = false;
+        if (cache)
+            hit = synthesize_cached(*job, *cache, control);
+        else
+            job->synthesize(control);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        // Publish unless cancelled, the job's grid becomes the front buffer
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_cancel) {
+            batch_result back{job->seed(), std::move(job->get_grid()), elapsed.count(), hit};
+            std::swap(m_front, back);
+            std::swap(m_front_profile, profile);
+            std::swap(m_front_thumbnails, thumbnails);
+            std::swap(m_front_timeline, timeline);
+            m_has_result = true;
+        }
+        m_running = false;
+        m_busy = m_pending != nullptr;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "grid_synth.hpp"
+#include "batch.hpp"
+#include "synthesis_timeline.hpp"
+
+namespace gs
+{
+
+class result_cache;
+class stage_cache;
+
+////////////////////////////////////////////////////////////////////////////////
+////                          synthesis_worker
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Runs syntheses on a background thread
+///
+/// Jobs are snapshots of a synthesizer (see grid_synth::clone()), so the
+/// original can keep being edited while the job runs. Starting a new job
+/// cancels the running one. Finished grids are handed back through a double
+/// buffer: the worker fills the back result and swaps it to the front, the
+/// owner takes the front one when it polls.
+class synthesis_worker
+{
+public:
+    /// @brief Constructor, starts the thread
+    synthesis_worker();
+
+    /// @brief Destructor, cancels the running job and joins the thread
+    ~synthesis_worker();
+
+    synthesis_worker(const synthesis_worker&) = delete;
+    synthesis_worker& operator=(const synthesis_worker&) = delete;
+
+    /// @brief Start synthesizing a job, cancelling the running one
+    /// @param job Snapshot of the synthesizer to run
+    /// @param cache Optional result cache to consult, must outlive the job
+    /// @param stages Optional stage output cache, must outlive the job
+    void start(grid_synth job, result_cache* cache = nullptr, stage_cache* stages = nullptr);
+
+    /// @brief Cancel the running and pending job
+    void cancel();
+
+    /// @brief Check if a job is pending or running
+    /// @return True while there is work to do
+    bool busy() const { return m_busy; }
+
+    /// @brief Get the progress of the running job
+    /// @return Fraction of the stages done, between 0 and 1
+    float progress() const { return m_progress; }
+
+    /// @brief Check if a finished result is waiting to be taken
+    /// @return True if take_result() would return a result
+    bool has_result() const { return m_has_result; }
+
+    /// @brief Take the result of the last finished job
+    /// @param result Receives the result, its previous grid is recycled
+    /// @param profile Optionally receives the per-stage profile of the job,
+    ///        empty when the result came from the result cache
+    /// @param thumbnails Optionally receives the stage thumbnails of the job,
+    ///        empty when the result came from the result cache or they are off
+    /// @param timeline Optionally receives the recording of the job, empty
+    ///        when the result came from the result cache or recording is off
+    /// @return True if there was a new result
+    bool take_result(batch_result& result,
+                     std::vector<stage_profile>* profile = nullptr,
+                     std::vector<stage_thumbnail>* thumbnails = nullptr,
+                     synthesis_timeline* timeline = nullptr);
+
+    /// @brief Make stage thumbnails for the jobs started from now on
+    /// @param size Largest side of the thumbnails in cells, 0 for none
+    void set_thumbnail_size(int size) { m_thumbnail_size = size; }
+
+    /// @brief Record a timeline of the jobs started from now on
+    /// @param max_bytes Memory budget of the recording, 0 for none
+    void set_timeline_budget(size_t max_bytes) { m_timeline_budget = max_bytes; }
+
+private:
+    void run();
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_quit = false;
+    bool m_running = false;                 ///< Whether the thread is working on a job
+
+    std::unique_ptr<grid_synth> m_pending;  ///< Job waiting to be started
+    result_cache* m_pending_cache = nullptr;
+    stage_cache* m_pending_stages = nullptr;
+    std::atomic<bool> m_cancel{false};      ///< Cancels the running job
+    std::atomic<bool> m_busy{false};
+    std::atomic<float> m_progress{0.0f};
+
+    batch_result m_front{0, grid(0, 0), 0.0, false};   ///< Finished result, swapped out by take_result()
+    std::vector<stage_profile> m_front_profile;         ///< Profile of the finished result
+    std::vector<stage_thumbnail> m_front_thumbnails;    ///< Stage thumbnails of the finished result
+    std::atomic<int> m_thumbnail_size{0};
+    synthesis_timeline m_front_timeline;                ///< Recording of the finished result
+    std::atomic<size_t> m_timeline_budget{0};
+    std::atomic<bool> m_has_result{false};
+};
+
+}
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "tilemap.hpp"
+#include "deflate.hpp"
+
+using namespace gs;
+
+////////////////////////////////////////////////////////////////////////////////
+////                            tile_mapping
+////////////////////////////////////////////////////////////////////////////////
+
+tile_mapping tile_mapping::from_alphabet(const alphabet& a)
+{
+    tile_mapping m;
+    uint32_t next = 1;
+    for (const auto& s : a.get_symbols()) {
+        if (s.id == alphabet::empty_symbol.id || s.id == alphabet::wildcard_symbol.id)
+            continue;
+        m.set(s.id, next++, s.name);
+    }
+    return m;
+}
+
+void tile_mapping::set(int symbol_id, uint32_t tile_id, const std::string& name)
+{
+    auto it = m_index.find(symbol_id);
+    if (it != m_index.end()) {
+        m_tiles[it->second].tile_id = tile_id;
+        if (!name.empty())
+            m_tiles[it->second].name = name;
+        return;
+    }
+    m_index.emplace(symbol_id, m_tiles.size());
+    m_tiles.push_back({symbol_id, tile_id, name});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////                            tilemap export
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    /// Streaming base64 encoder, keeps at most two bytes between writes
+    class base64_writer
+    {
+    public:
+        explicit base64_writer(std::ostream& out) : m_out(out) {}
+
+        void write(const uint8_t* data, size_t size)
+        {
+            size_t i = 0;
+            while (m_count > 0 && m_count < 3 && i < size)
+                m_carry[m_count++] = data[i++];
+            if (m_count == 3) {
+                encode(m_carry, 3);
+                m_count = 0;
+            }
+
+            // Encode whole groups straight from the input
+            m_text.clear();
+            for (; i + 3 <= size; i += 3)
+                append(data + i, 3);
+            m_out.write(m_text.data(), (std::streamsize)m_text.size());
+
+            while (i < size)
+                m_carry[m_count++] = data[i++];
+        }
+
+        void finish()
+        {
+            if (m_count > 0)
+                encode(m_carry, m_count);
+            m_count = 0;
+        }
+
+    private:
+        void encode(const uint8_t* data, size_t size)
+        {
+            m_text.clear();
+            append(data, size);
+            m_out.write(m_text.data(), (std::streamsize)m_text.size());
+        }
+
+        void append(const uint8_t* d, size_t size)
+        {
+            static const char* digits =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            uint32_t v = (uint32_t)d[0] << 16;
+            if (size > 1) v |= (uint32_t)d[1] << 8;
+            if (size > 2) v |= d[2];
+            m_text.push_back(digits[(v >> 18) & 63]);
+            m_text.push_back(digits[(v >> 12) & 63]);
+            m_text.push_back(size > 1 ? digits[(v >> 6) & 63] : '=');
+            m_text.push_back(size > 2 ? digits[v & 63] : '=');
+        }
+
+        std::ostream& m_out;
+        std::string m_text;
+        uint8_t m_carry[3] = {};
+        size_t m_count = 0;
+    };
+
+    std::string xml_escape(const std::string& s)
+    {
+        std::string out;
+        out.reserve(s.size());
+        for (char c : s) {
+            switch (c) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += "&quot;"; break;
+                case '\'': out += "&apos;"; break;
+                default: out += c;
+            }
+        }
+        return out;
+    }
+
+    /// Write the tile IDs of a grid as comma separated rows
+    void write_csv_rows(std::ostream& out, const grid& g, const tile_mapping& mapping, bool tiled)
+    {
+        // Cache the last lookup, neighbouring cells usually hold the same symbol
+        int last_symbol = alphabet::empty_symbol.id;
+        uint32_t last_tile = mapping.get(last_symbol);
+
+        std::string row;
+        char number[16];
+        for (int y = 0; y < g.height(); ++y) {
+            row.clear();
+            for (int x = 0; x < g.width(); ++x) {
+                int s = g(x, y);
+                if (s != last_symbol) {
+                    last_symbol = s;
+                    last_tile = mapping.get(s);
+                }
+                auto result = std::to_chars(number, number + sizeof(number), last_tile);
+                row.append(number, result.ptr);
+                if (x + 1 < g.width())
+                    row.push_back(',');
+            }
+            // Tiled separates rows with a comma as well, all but the last
+            if (tiled && y + 1 < g.height())
+                row.push_back(',');
+            row.push_back('\n');
+            out.write(row.data(), (std::streamsize)row.size());
+        }
+    }
+
+    /// Write the tile IDs of a grid as base64 encoded, zlib compressed little-endian words
+    void write_base64_zlib(std::ostream& out, const grid& g, const tile_mapping& mapping)
+    {
+        base64_writer base64(out);
+        const size_t stride = (size_t)g.width() * 4;
+        deflater compressor([&](const uint8_t* data, size_t size) { base64.write(data, size); },
+                            deflate_mode::fixed, true, stride);
+
+        int last_symbol = alphabet::empty_symbol.id;
+        uint32_t last_tile = mapping.get(last_symbol);
+
+        std::vector<uint8_t> row(stride);
+        for (int y = 0; y < g.height(); ++y) {
+            uint8_t* p = row.data();
+            for (int x = 0; x < g.width(); ++x) {
+                int s = g(x, y);
+                if (s != last_symbol) {
+                    last_symbol = s;
+                    last_tile = mapping.get(s);
+                }
+                *p++ = (uint8_t)last_tile;
+                *p++ = (uint8_t)(last_tile >> 8);
+                *p++ = (uint8_t)(last_tile >> 16);
+                *p++ = (uint8_t)(last_tile >> 24);
+            }
+            compressor.write(row.data(), row.size());
+        }
+        compressor.finish();
+        base64.finish();
+    }
+
+    void write_tmx(std::ostream& out, const grid& g, const tile_mapping& mapping, const tilemap_options& options)
+    {
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<map version=\"1.10\" orientation=\"orthogonal\" renderorder=\"right-down\""
+            << " width=\"" << g.width() << "\" height=\"" << g.height() << "\""
+            << " tilewidth=\"" << options.tile_width << "\" tileheight=\"" << options.tile_height << "\""
+            << " infinite=\"0\" nextlayerid=\"2\" nextobjectid=\"1\">\n";
+
+        if (!options.tileset_source.empty()) {
+            out << " <tileset firstgid=\"1\" source=\"" << xml_escape(options.tileset_source) << "\"/>\n";
+        }
+        else {
+            // Embedded image collection tileset, one tile per symbol carrying its name
+            uint32_t count = 0;
+            for (const auto& t : mapping.tiles())
+                count = std::max(count, t.tile_id);
+            out << " <tileset firstgid=\"1\" name=\"symbols\""
+                << " tilewidth=\"" << options.tile_width << "\" tileheight=\"" << options.tile_height << "\""
+                << " tilecount=\"" << count << "\" columns=\"0\">\n"
+                << "  <grid orientation=\"orthogonal\" width=\"1\" height=\"1\"/>\n";
+            for (const auto& t : mapping.tiles()) {
+                if (t.tile_id == 0)
+                    continue;
+                out << "  <tile id=\"" << t.tile_id - 1 << "\">\n"
+                    << "   <properties>\n"
+                    << "    <property name=\"symbol\" value=\"" << xml_escape(t.name) << "\"/>\n"
+                    << "    <property name=\"symbol_id\" type=\"int\" value=\"" << t.symbol_id << "\"/>\n"
+                    << "   </properties>\n"
+                    << "  </tile>\n";
+            }
+            out << " </tileset>\n";
+        }
+
+        out << " <layer id=\"1\" name=\"" << xml_escape(options.layer_name) << "\""
+            << " width=\"" << g.width() << "\" height=\"" << g.height() << "\">\n";
+        if (options.format == tilemap_format::tmx_base64_zlib) {
+            out << "  <data encoding=\"base64\" compression=\"zlib\">\n   ";
+            write_base64_zlib(out, g, mapping);
+            out << "\n  </data>\n";
+        }
+        else {
+            out << "  <data encoding=\"csv\">\n";
+            write_csv_rows(out, g, mapping, true);
+            out << "</data>\n";
+        }
+        out << " </layer>\n"
+            << "</map>\n";
+    }
+}
+
+tilemap_format gs::tilemap_format_from_filename(const std::string& filename)
+{
+    std::string ext = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".csv" ? tilemap_format::csv : tilemap_format::tmx_csv;
+}
+
+void gs::write_tilemap(std::ostream& out, const grid& g, const tile_mapping& mapping, const tilemap_options& options)
+{
+    if (options.format == tilemap_format::csv)
+        write_csv_rows(out, g, mapping, false);
+    else
+        write_tmx(out, g, mapping, options);
+
+    if (!out)
+        throw std::runtime_error("Failed to write tilemap");
+}
+
+bool gs::save_tilemap(const std::string& filename, const grid& g, const tile_mapping& mapping, const tilemap_options& options)
+{
+    try {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file for writing: " << filename << std::endl;
+            return false;
+        }
+
+        write_tilemap(file, g, mapping, options);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error saving tilemap: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+batch_sink gs::tilemap_sink(const std::string& directory, const tile_mapping& mapping, const tilemap_options& options)
+{
+    std::string extension = options.format == tilemap_format::csv ? ".csv" : ".tmx";
+    return [directory, extension, mapping, options](const batch_result& result) {
+        save_tilemap(directory + "/" + std::to_string(result.seed) + extension, result.output, mapping, options);
+    };
+}
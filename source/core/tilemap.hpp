@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "grid_synth.hpp"
+#include "batch.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            tile_mapping
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Maps symbol IDs to tile IDs of a game engine tileset
+///
+/// Tile IDs follow the Tiled convention: 0 is "no tile" and tileset tiles
+/// start at 1. Symbols without an entry map to 0.
+class tile_mapping
+{
+public:
+    /// @brief A tile of the tileset
+    struct tile {
+        int symbol_id;          ///< Symbol the tile represents
+        uint32_t tile_id;       ///< Tile ID (Tiled global ID)
+        std::string name;       ///< Name of the symbol
+    };
+
+    /// @brief Constructor, creates an empty mapping
+    tile_mapping() = default;
+
+    /// @brief Create a mapping with one tile per alphabet symbol
+    ///
+    /// Tiles are numbered from 1 in alphabet order. The empty symbol and the
+    /// wildcard map to 0.
+    /// @param a The alphabet
+    /// @return The mapping
+    static tile_mapping from_alphabet(const alphabet& a);
+
+    /// @brief Set the tile ID of a symbol
+    /// @param symbol_id The symbol ID
+    /// @param tile_id The tile ID
+    /// @param name Name of the symbol, stored in the tileset
+    void set(int symbol_id, uint32_t tile_id, const std::string& name = "");
+
+    /// @brief Get the tile ID of a symbol
+    /// @param symbol_id The symbol ID
+    /// @return The tile ID, or 0 if the symbol has no tile
+    uint32_t get(int symbol_id) const
+    {
+        auto it = m_index.find(symbol_id);
+        return it != m_index.end() ? m_tiles[it->second].tile_id : 0;
+    }
+
+    /// @brief Get all tiles
+    /// @return The tiles, in the order they were added
+    const std::vector<tile>& tiles() const { return m_tiles; }
+
+private:
+    std::vector<tile> m_tiles;
+    std::unordered_map<int, size_t> m_index;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////                            tilemap export
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Streaming export of grids for game engines
+///
+/// Grids are written straight from the grid buffer row by row, either as
+/// plain CSV of tile IDs or as a Tiled TMX map with a CSV or base64+zlib
+/// encoded layer. Nothing is built up in memory besides one row of text and,
+/// for compressed layers, the 32K deflate window.
+
+/// @brief Tilemap file formats
+enum class tilemap_format
+{
+    csv,                ///< Plain CSV, one line per row
+    tmx_csv,            ///< Tiled TMX with a CSV encoded layer
+    tmx_base64_zlib     ///< Tiled TMX with a base64 encoded, zlib compressed layer
+};
+
+/// @brief Options for tilemap export
+struct tilemap_options
+{
+    tilemap_format format = tilemap_format::tmx_csv;    ///< Output format
+    int tile_width = 16;                                ///< Tile width in pixels (TMX only)
+    int tile_height = 16;                               ///< Tile height in pixels (TMX only)
+    std::string tileset_source;                         ///< External tileset (.tsx), embedded tileset when empty
+    std::string layer_name = "grid";                    ///< Name of the tile layer (TMX only)
+};
+
+/// @brief Guess the tilemap format from a file name
+/// @param filename The file name
+/// @return tilemap_format::csv for .csv files, tilemap_format::tmx_csv otherwise
+tilemap_format tilemap_format_from_filename(const std::string& filename);
+
+/// @brief Write a grid as a tilemap
+/// @param out The stream to write to
+/// @param g The grid
+/// @param mapping Symbol to tile ID mapping
+/// @param options Export options
+/// @throws std::runtime_error if writing fails
+void write_tilemap(std::ostream& out, const grid& g, const tile_mapping& mapping, const tilemap_options& options = {});
+
+/// @brief Save a grid as a tilemap
+/// @param filename Path to the file
+/// @param g The grid
+/// @param mapping Symbol to tile ID mapping
+/// @param options Export options
+/// @return True if save was successful, false otherwise
+bool save_tilemap(const std::string& filename, const grid& g, const tile_mapping& mapping, const tilemap_options& options = {});
+
+/// @brief Create a batch sink that saves every result as a tilemap
+///
+/// Files are named after the seed, e.g. "<directory>/12345.tmx".
+/// @param directory Directory to write to
+/// @param mapping Symbol to tile ID mapping
+/// @param options Export options
+/// @return The sink
+batch_sink tilemap_sink(const std::string& directory, const tile_mapping& mapping, const tilemap_options& options = {});
+
+}
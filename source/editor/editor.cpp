@@ -1,8 +1,16 @@
 #include "editor.hpp"
+#include "minimap.hpp"
+#include "core/grid_paint.hpp"
+#include "core/image.hpp"
+#include "core/tilemap.hpp"
+#include "core/hash.hpp"
 #include "imgui.h"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
 #include <nlohmann/json.hpp>
 
 #ifdef USE_PORTABLE_FILE_DIALOGS
@@ -15,11 +23,35 @@ using namespace std;
 
 namespace
 {
-    ImColor nice_color(int idx)
+    // Largest grid side the editor allows
+    const int max_grid_size = 16384;
+
+    // Quiet time after an edit before auto synthesis starts, in seconds
+    const double auto_synthesize_delay = 0.25;
+
+    // Largest side of the stage thumbnails made by the worker, in cells
+    const int stage_thumbnail_size = 64;
+
+    // File tasks read and write in chunks of this size to report progress
+    const size_t file_chunk_size = 1 << 20;
+
+    // Side of the pattern preview region in cells, and on screen in pixels
+    const int preview_cells = 24;
+    const float preview_pixels = 192.0f;
+
+    // Height of the stage thumbnails in the Transformation Stack window
+    const float stage_preview_height = 32.0f;
+
+    // Memory budget of the recorded synthesis timeline
+    const size_t timeline_budget = 128ull * 1024 * 1024;
+
+    // Pipeline as recorded in the undo history, the seed is left out so
+    // rolling a new one is not a step of its own
+    std::string pipeline_state(const grid_synth& synth)
     {
-        static double golden_ratio_conjugate = 0.618033988749895;
-        float hue = (float)std::fmod(idx * golden_ratio_conjugate, 1.0);
-        return ImColor::HSV(hue, 0.8f, 0.6f);
+        nlohmann::json j = synth.pipeline_to_json();
+        j.erase("seed");
+        return j.dump();
     }
 
     // Helper function to ensure no zero dimensions for ImGui elements
@@ -32,8 +64,15 @@ namespace
     }
 }
 
-editor::editor()
+editor::editor(SDL_Renderer* renderer)
     : m_synth(16, 16, alphabet::empty_symbol.id),
+      m_cache(result_cache::default_directory()),
+      m_gallery(std::make_unique<variant_gallery>(renderer, m_pool)),
+      m_match_overlay(renderer),
+      m_canvas(renderer),
+      m_renderer(renderer),
+      m_stage_canvas(renderer),
+      m_timeline_canvas(renderer),
       m_pattern_grid(3, 3, alphabet::wildcard_symbol.id),
       m_search_pattern(3, 3, alphabet::wildcard_symbol.id),
       m_replacement_pattern(3, 3, alphabet::wildcard_symbol.id)
@@ -71,14 +110,112 @@ editor::editor()
     rule_ptr->set_search(search);
     rule_ptr->add_replacement(1.0f, replacement);
     m_synth.add_transformation(move(rule));
+
+    m_history_pipeline = pipeline_state(m_synth);
+    m_canvas.set_overlay(&m_match_overlay);
+
+    m_documents.emplace_back();
+    m_documents[0].id = m_next_document_id++;
+    m_gallery->focus();
 }
 
 void editor::edit()
 {
+    auto frame_start = std::chrono::steady_clock::now();
+
+    // Finished file tasks and closed dialogs are handled at the frame
+    // boundary, so a loaded document never replaces one being drawn
+    m_file_task.poll();
+    if (m_pending_dialog && m_pending_dialog()) {
+        m_pending_dialog = nullptr;
+    }
+    update_watch();
+
+    // A load finishes on the focused document, so projects are opened one
+    // at a time, each in its own tab
+    if (!m_pending_opens.empty() && !m_file_task.busy()) {
+        auto [filename, watch] = std::move(m_pending_opens.front());
+        m_pending_opens.erase(m_pending_opens.begin());
+        if (m_filename[0] != '\0' || m_history.size() > 0)
+            new_document();
+        if (load_from_file(filename) && watch)
+            m_watcher.watch(filename);
+    }
+
+    // Tabs closed or selected during the last frame
+    if (m_close_request != SIZE_MAX) {
+        close_document(m_close_request);
+        m_close_request = SIZE_MAX;
+    }
+    if (m_focus_request != SIZE_MAX) {
+        focus_document(m_focus_request);
+        m_focus_request = SIZE_MAX;
+    }
+
+    m_render_cache.update(*m_synth.get_alphabet());
+
+    // Undo and redo, text fields keep their own shortcuts
+    ImGuiIO& io = ImGui::GetIO();
+    if (io.KeyCtrl && !io.WantTextInput) {
+        if (ImGui::IsKeyPressed(ImGuiKey_Z, false)) {
+            if (io.KeyShift)
+                redo();
+            else
+                undo();
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_Y, false)) {
+            redo();
+        }
+    }
+
     edit_alphabet();
     edit_transformation_stack();
     edit_selected_transformation();
+    auto synthesizer_start = std::chrono::steady_clock::now();
     edit_synthesizer();
+    auto synthesizer_end = std::chrono::steady_clock::now();
+    edit_minimap();
+    edit_stage_output();
+    edit_timeline();
+    edit_gallery();
+
+    update_history();
+
+    // Performance panel, the numbers are collected even while it is closed
+    // so the peaks and percentiles are there when it is opened
+    auto grid_bytes = [](const grid& g) { return (size_t)g.width() * g.height() * sizeof(int); };
+    m_perf.track_memory("Grid", grid_bytes(m_synth.get_grid()));
+    m_perf.track_memory("Auto source grid", grid_bytes(m_source_grid));
+    m_perf.track_memory("Result buffer", grid_bytes(m_result.output));
+    m_perf.track_memory("Canvas", m_canvas.bytes());
+    m_perf.track_memory("Stage output", grid_bytes(m_stage_output) + m_stage_canvas.bytes());
+    m_perf.track_memory("Timeline", m_timeline.bytes() + m_timeline_canvas.bytes());
+    size_t variant_bytes = m_gallery->bytes();
+    for (const auto& d : m_documents)
+        if (d.gallery)
+            variant_bytes += d.gallery->bytes();
+    m_perf.track_memory("Variants", variant_bytes);
+    m_perf.track_memory("Stage cache", m_stage_cache.bytes());
+    m_perf.track_memory("Undo history", m_history.bytes());
+
+    std::chrono::duration<float> editor_time = std::chrono::steady_clock::now() - frame_start;
+    std::chrono::duration<float> synthesizer_time = synthesizer_end - synthesizer_start;
+    m_perf.add_frame(io.DeltaTime, editor_time.count(), synthesizer_time.count());
+
+    if (m_show_perf) {
+        m_perf.draw(&m_show_perf);
+    }
+}
+
+bool editor::wants_continuous_update() const
+{
+    if (m_worker.busy() || m_worker.has_result() || m_auto_deadline >= 0.0 ||
+        m_gallery->busy() || m_file_task.busy() || m_pending_dialog || !m_pending_opens.empty())
+        return true;
+
+    // Background tabs show the progress of their variants in the tab label
+    return std::any_of(m_documents.begin(), m_documents.end(),
+                       [](const document& d) { return d.gallery && d.gallery->busy(); });
 }
 
 void editor::edit_alphabet()
@@ -156,8 +293,19 @@ void editor::edit_transformation_stack()
 
     auto& transformations = m_synth.get_transformations();
 
+    if (ImGui::Checkbox("Stage previews", &m_show_stage_previews)) {
+        m_worker.set_thumbnail_size(m_show_stage_previews ? stage_thumbnail_size : 0);
+    }
+
+    // Keep the thumbnails next to their stage when the stack is reordered
+    if (m_stage_previews.size() < transformations.size())
+        m_stage_previews.resize(transformations.size());
+
     // Table with transformations
-    if (ImGui::BeginTable("##TransformationTable", 4)) {
+    const int columns = m_show_stage_previews ? 5 : 4;
+    if (ImGui::BeginTable("##TransformationTable", columns)) {
+        if (m_show_stage_previews)
+            ImGui::TableSetupColumn("Output");
         ImGui::TableSetupColumn("##Enabled");
         ImGui::TableSetupColumn("Name");
         ImGui::TableSetupColumn("Type");
@@ -169,6 +317,26 @@ void editor::edit_transformation_stack()
 
             ImGui::TableNextRow();
 
+            // Output Column, thumbnails are from the last synthesis and may
+            // be out of date after edits
+            if (m_show_stage_previews) {
+                ImGui::TableNextColumn();
+                const stage_preview* preview = i < m_stage_previews.size() ? &m_stage_previews[i] : nullptr;
+                if (preview && preview->valid && preview->texture && preview->texture->texture()) {
+                    const float scale = stage_preview_height / std::max(preview->width, preview->height);
+                    ImVec2 size(preview->width * scale, preview->height * scale);
+                    if (ImGui::ImageButton(("##preview" + std::to_string(i)).c_str(),
+                                           (ImTextureID)(intptr_t)preview->texture->texture(), size)) {
+                        show_stage_output(i);
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("Show the full output of this stage");
+                    }
+                } else {
+                    ImGui::TextDisabled("-");
+                }
+            }
+
             // Enabled Column
             ImGui::TableNextColumn();
             bool enabled = transform->enabled();
@@ -204,6 +372,7 @@ void editor::edit_transformation_stack()
                 if (ImGui::Button("↑")) {
                     // Swap with previous element
                     std::swap(transformations[i], transformations[i-1]);
+                    std::swap(m_stage_previews[i], m_stage_previews[i-1]);
                     if (m_selected_transform_index == (int)i) {
                         m_selected_transform_index = (int)i - 1;
                     } else if (m_selected_transform_index == (int)i - 1) {
@@ -221,6 +390,7 @@ void editor::edit_transformation_stack()
                 if (ImGui::Button("↓")) {
                     // Swap with next element
                     std::swap(transformations[i], transformations[i+1]);
+                    std::swap(m_stage_previews[i], m_stage_previews[i+1]);
                     if (m_selected_transform_index == (int)i) {
                         m_selected_transform_index = (int)i + 1;
                     } else if (m_selected_transform_index == (int)i + 1) {
@@ -246,6 +416,7 @@ void editor::edit_transformation_stack()
     std::sort(m_transforms_to_remove.begin(), m_transforms_to_remove.end(), std::greater<int>());
     for (int idx : m_transforms_to_remove) {
         transformations.erase(transformations.begin() + idx);
+        m_stage_previews.erase(m_stage_previews.begin() + idx);
         if (m_selected_transform_index == idx) {
             m_selected_transform_index = -1;
         } else if (m_selected_transform_index > idx) {
@@ -464,33 +635,21 @@ void editor::edit_rule_based_transformation(rule_based_transformation* transform
                     ImVec2 cell_min(cursor.x + x * cell_size, cursor.y + y * cell_size);
                     ImVec2 cell_max(cell_min.x + cell_size, cell_min.y + cell_size);
 
-                    int symbol_id = m_pattern_grid(x, y);
-                    ImColor cell_color = nice_color(symbol_id);
+                    const auto cell = m_render_cache.get(m_pattern_grid(x, y));
 
                     // Draw cell
-                    draw_list->AddRectFilled(cell_min, cell_max, cell_color);
+                    draw_list->AddRectFilled(cell_min, cell_max, cell.color);
                     draw_list->AddRect(cell_min, cell_max, IM_COL32(200, 200, 200, 255));
 
                     // Draw symbol text in cell
-                    std::string symbol_text;
-                    if (symbol_id == alphabet::wildcard_symbol.id) {
-                        symbol_text = "*";
-                    } else if (symbol_id == alphabet::empty_symbol.id) {
-                        symbol_text = " ";
-                    } else if (alphabet_ptr->has_symbol(symbol_id)) {
-                        symbol_text = alphabet_ptr->get_symbol(symbol_id).name;
-                    } else {
-                        symbol_text = "?";
+                    if (cell.label) {
+                        ImVec2 text_pos(
+                            cell_min.x + (cell_size - cell.label_size.x) * 0.5f,
+                            cell_min.y + (cell_size - cell.label_size.y) * 0.5f
+                        );
+                        draw_list->AddText(text_pos, IM_COL32(255, 255, 255, 255), cell.label);
                     }
 
-                    ImVec2 text_size = ImGui::CalcTextSize(symbol_text.c_str());
-                    ImVec2 text_pos(
-                        cell_min.x + (cell_size - text_size.x) * 0.5f,
-                        cell_min.y + (cell_size - text_size.y) * 0.5f
-                    );
-
-                    draw_list->AddText(text_pos, IM_COL32(255, 255, 255, 255), symbol_text.c_str());
-
                     // Handle cell clicks
                     if (ImGui::IsMouseHoveringRect(cell_min, cell_max) && ImGui::IsMouseClicked(0)) {
                         m_pattern_grid(x, y) = m_selected_symbol_id;
@@ -504,6 +663,8 @@ void editor::edit_rule_based_transformation(rule_based_transformation* transform
                 std::max(1.0f, grid_height)
             ));
 
+            ImGui::Separator();
+            edit_pattern_preview();
             ImGui::Separator();
 
             // Apply changes button
@@ -541,11 +702,77 @@ void editor::edit_rule_based_transformation(rule_based_transformation* transform
     }
 }
 
+void editor::edit_pattern_preview()
+{
+    const auto& g = m_synth.get_grid();
+    if (!m_current_rule || g.width() < 1 || g.height() < 1)
+        return;
+
+    // Region around the last hovered cell, kept inside the grid
+    const int size = std::min(preview_cells, std::min(g.width(), g.height()));
+    const int cx = m_preview_x >= 0 ? m_preview_x : g.width() / 2;
+    const int cy = m_preview_y >= 0 ? m_preview_y : g.height() / 2;
+    const int x0 = std::clamp(cx - size / 2, 0, g.width() - size);
+    const int y0 = std::clamp(cy - size / 2, 0, g.height() - size);
+
+    // Only rerun the rule when the pattern, the region or its cells changed
+    uint64_t key = hash_combine(hash_combine(x0, y0), hash_combine(size, m_editing_search));
+    key = hash_bytes(m_pattern_grid.raw_data(), (size_t)m_pattern_grid.width() * m_pattern_grid.height() * sizeof(int),
+                     hash_combine(key, hash_combine(m_pattern_grid.width(), m_pattern_grid.height())));
+    for (int y = y0; y < y0 + size; ++y)
+        key = hash_bytes(g.raw_data() + (size_t)y * g.width() + x0, size * sizeof(int), key);
+    if (key != m_preview_key) {
+        m_preview_key = key;
+
+        // The rule as it will be once the pattern is applied
+        auto copy = m_current_rule->clone(m_synth.get_alphabet());
+        auto* rule = static_cast<rule_based_transformation*>(copy.get());
+        if (m_editing_search)
+            rule->set_search(m_pattern_grid);
+        else if (rule->replacement_count() > 0)
+            rule->update_replacement(0, 1.0f, m_pattern_grid);
+        else
+            rule->add_replacement(1.0f, m_pattern_grid);
+
+        m_preview_before.resize(size, size);
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                m_preview_before(x, y) = g(x0 + x, y0 + y);
+        m_preview_matches = rule->apply_region(g, m_preview_after, x0, y0, x0 + size - 1, y0 + size - 1);
+    }
+
+    ImGui::Text("Preview at %d, %d: %zu matches", x0, y0, m_preview_matches);
+    ImGui::TextDisabled("Around the last cell hovered on the grid canvas");
+
+    // Before and after side by side, changed cells outlined
+    const float cell_size = preview_pixels / size;
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float spacing = ImGui::GetStyle().ItemSpacing.x * 2.0f;
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    for (int side = 0; side < 2; ++side) {
+        const grid& region = side == 0 ? m_preview_before : m_preview_after;
+        const float left = origin.x + side * (preview_pixels + spacing);
+        for (int y = 0; y < region.height(); ++y) {
+            for (int x = 0; x < region.width(); ++x) {
+                ImVec2 cell_min(left + x * cell_size, origin.y + y * cell_size);
+                ImVec2 cell_max(cell_min.x + cell_size, cell_min.y + cell_size);
+                draw_list->AddRectFilled(cell_min, cell_max, m_render_cache.get(region(x, y)).color);
+                if (side == 1 && region(x, y) != m_preview_before(x, y))
+                    draw_list->AddRect(cell_min, cell_max, IM_COL32(255, 255, 255, 255));
+            }
+        }
+    }
+    ImGui::Dummy(ImVec2(preview_pixels * 2.0f + spacing, preview_pixels));
+}
+
 void editor::edit_synthesizer()
 {
     ImGui::Begin("Synthesizer");
 
-    // File operations
+    edit_documents();
+
+    // File operations, one at a time
+    ImGui::BeginDisabled(m_file_task.busy() || m_pending_dialog);
     if (ImGui::Button("Save")) {
         show_file_dialog(true);
     }
@@ -556,8 +783,103 @@ void editor::edit_synthesizer()
     }
     ImGui::SameLine();
 
+    if (ImGui::Button("Import")) {
+        show_import_dialog();
+    }
+    ImGui::SameLine();
+
+    if (ImGui::Button("Export")) {
+        show_export_dialog();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+
+    // Reload the project when other programs change it
+    bool watch = m_watcher.watching();
+    ImGui::BeginDisabled(!watch && m_filename[0] == '\0');
+    if (ImGui::Checkbox("Watch", &watch)) {
+        set_watch(watch);
+    }
+    ImGui::EndDisabled();
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+        if (m_watch_status.empty())
+            ImGui::SetTooltip("Reload the project when its file changes on disk");
+        else
+            ImGui::SetTooltip("%s", m_watch_status.c_str());
+    }
+    ImGui::SameLine();
+    if (m_file_task.busy()) {
+        ImGui::ProgressBar(m_file_task.progress(), ImVec2(100, 0));
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%s", m_file_task.label().c_str());
+        }
+        ImGui::SameLine();
+    } else if (!m_file_status.empty()) {
+        ImGui::TextDisabled("(failed)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%s", m_file_status.c_str());
+        }
+        ImGui::SameLine();
+    }
+
+    // Pick up the result of a background synthesis
+    std::vector<stage_profile> profile;
+    std::vector<stage_thumbnail> thumbnails;
+    if (m_worker.take_result(m_result, &profile, &thumbnails, &m_timeline)) {
+        m_perf.set_profile(std::move(profile), m_result.cache_hit);
+        update_stage_previews(thumbnails);
+        m_timeline_frame = std::max(0, (int)m_timeline.size() - 1);
+        m_timeline_canvas.invalidate();
+        commit_stroke();
+        std::swap(m_synth.get_grid(), m_result.output);
+        m_last_cache_hit = m_result.cache_hit;
+        m_canvas.invalidate();
+        // Auto runs follow the pipeline, undoing a pipeline edit reruns them
+        if (!m_auto_synthesize) {
+            record_grid_change("Synthesize", m_result.output);
+        }
+    }
+
     if (ImGui::Button("Synthesize")) {
-        m_synth.synthesize();
+        if (!m_lock_seed) {
+            static std::random_device rd;
+            m_synth.set_seed(rd());
+        }
+        start_synthesis();
+    }
+
+    // Seed controls
+    int seed = (int)m_synth.seed();
+    ImGui::SameLine();
+    ImGui::PushItemWidth(100);
+    if (ImGui::InputInt("Seed", &seed)) {
+        m_synth.set_seed((uint32_t)seed);
+    }
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox("Lock", &m_lock_seed);
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Auto", &m_auto_synthesize) && m_auto_synthesize) {
+        // Later runs start from the grid as it is now
+        m_source_grid = m_synth.get_grid();
+        m_auto_fingerprint = 0;
+    }
+    if (m_auto_synthesize) {
+        update_auto_synthesis();
+    }
+    if (m_worker.busy()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar(m_worker.progress(), ImVec2(100, 0));
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            m_worker.cancel();
+        }
+    } else if (m_last_cache_hit) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(cached)");
+    } else if (m_result.seconds > 0.0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(%.2fs)", m_result.seconds);
     }
 
     // Grid size controls
@@ -567,122 +889,122 @@ void editor::edit_synthesizer()
     ImGui::PushItemWidth(60);
     if (ImGui::InputInt("Width", &grid_width)) {
         if (grid_width < 1) grid_width = 1;
-        if (grid_width > 256) grid_width = 256;
+        if (grid_width > max_grid_size) grid_width = max_grid_size;
     }
 
     ImGui::SameLine();
 
     if (ImGui::InputInt("Height", &grid_height)) {
         if (grid_height < 1) grid_height = 1;
-        if (grid_height > 256) grid_height = 256;
+        if (grid_height > max_grid_size) grid_height = max_grid_size;
     }
     ImGui::PopItemWidth();
 
     ImGui::SameLine();
 
     if (ImGui::Button("Resize")) {
+        grid before = m_synth.get_grid();
         m_synth.get_grid().resize(grid_width, grid_height);
+        record_grid_change("Resize", before);
+        m_canvas.invalidate();
+        m_canvas.fit();
+        source_grid_changed();
     }
 
     ImGui::SameLine();
 
     if (ImGui::Button("Clear")) {
+        grid before = m_synth.get_grid();
         m_synth.get_grid().clear(alphabet::empty_symbol.id);
+        record_grid_change("Clear", before);
+        m_canvas.invalidate();
+        source_grid_changed();
     }
 
-    // Visualize the grid
-    auto& grid = m_synth.get_grid();
-    auto alphabet_ptr = m_synth.get_alphabet(); // Removed reference
+    ImGui::SameLine();
 
-    // Calculate grid visualization parameters
-    float available_width = ImGui::GetContentRegionAvail().x;
-    float available_height = ImGui::GetContentRegionAvail().y;
+    if (ImGui::Button("Fit")) {
+        m_canvas.fit();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Performance", &m_show_perf);
+    ImGui::SameLine();
+    ImGui::Checkbox("Variants", &m_show_gallery);
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Timeline", &m_show_timeline)) {
+        m_worker.set_timeline_budget(m_show_timeline ? timeline_budget : 0);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Minimap", &m_show_minimap);
 
-    // Ensure we're not dividing by zero
-    int safe_grid_width = std::max(1, grid.width());
-    int safe_grid_height = std::max(1, grid.height());
+    // History
+    ImGui::BeginDisabled(!m_history.can_undo());
+    if (ImGui::Button("Undo")) {
+        undo();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!m_history.can_redo());
+    if (ImGui::Button("Redo")) {
+        redo();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu steps, %.1f / %.0f MB", m_history.size(),
+                        m_history.bytes() / (1024.0 * 1024.0),
+                        m_history.max_bytes() / (1024.0 * 1024.0));
 
-    float cell_size = std::min(
-        available_width / safe_grid_width,
-        available_height / safe_grid_height
-    );
+    // Matches of the selected rule, or of the search pattern being edited
+    const grid* match_pattern = nullptr;
+    auto& transformations = m_synth.get_transformations();
+    if (m_editing_pattern && m_editing_search) {
+        match_pattern = &m_pattern_grid;
+    } else if (m_selected_transform_index >= 0 && m_selected_transform_index < (int)transformations.size()) {
+        if (auto* rule = dynamic_cast<rule_based_transformation*>(transformations[m_selected_transform_index].get()))
+            match_pattern = &rule->get_search();
+    }
+    m_match_overlay.set_pattern(m_show_matches ? match_pattern : nullptr);
+    ImGui::Checkbox("Show matches", &m_show_matches);
+    if (m_match_overlay.active()) {
+        ImGui::SameLine();
+        ImGui::Text("%zu matches", m_match_overlay.count());
+    }
 
-    cell_size = std::max(4.0f, std::min(32.0f, cell_size));
+    // Visualize the grid
+    auto& grid = m_synth.get_grid();
 
-    float grid_width_px = safe_grid_width * cell_size;
-    float grid_height_px = safe_grid_height * cell_size;
+    // Painting tools
+    int tool = (int)m_paint_tool;
+    ImGui::SameLine();
+    ImGui::RadioButton("Brush", &tool, (int)paint_tool::brush);
+    ImGui::SameLine();
+    ImGui::RadioButton("Line", &tool, (int)paint_tool::line);
+    ImGui::SameLine();
+    ImGui::RadioButton("Fill", &tool, (int)paint_tool::fill);
+    m_paint_tool = (paint_tool)tool;
+    if (m_paint_tool != paint_tool::fill) {
+        ImGui::SameLine();
+        ImGui::PushItemWidth(100);
+        ImGui::SliderInt("Radius", &m_brush_radius, 0, 32);
+        ImGui::PopItemWidth();
+    }
 
-    // Draw the grid
-    ImDrawList* draw_list = ImGui::GetWindowDrawList();
-    ImVec2 canvas_pos = ImGui::GetCursorScreenPos();
-    ImVec2 canvas_size(grid_width_px, grid_height_px);
-
-    // Background
-    draw_list->AddRectFilled(
-        canvas_pos,
-        ImVec2(canvas_pos.x + canvas_size.x, canvas_pos.y + canvas_size.y),
-        IM_COL32(50, 50, 50, 255)
-    );
-
-    // Grid cells
-    for (int y = 0; y < grid.height(); ++y) {
-        for (int x = 0; x < grid.width(); ++x) {
-            ImVec2 cell_min = ImVec2(
-                canvas_pos.x + x * cell_size,
-                canvas_pos.y + y * cell_size
-            );
-            ImVec2 cell_max = ImVec2(
-                cell_min.x + cell_size,
-                cell_min.y + cell_size
-            );
-
-            int symbol_id = grid(x, y);
-            ImColor color = nice_color(symbol_id);
-
-            draw_list->AddRectFilled(cell_min, cell_max, color);
-
-            // Add symbol text if cells are large enough
-            if (cell_size >= 12.0f) {
-                std::string symbol_text;
-                if (symbol_id == alphabet::wildcard_symbol.id) {
-                    symbol_text = "*";
-                } else if (symbol_id == alphabet::empty_symbol.id) {
-                    symbol_text = " ";
-                } else if (alphabet_ptr->has_symbol(symbol_id)) {
-                    symbol_text = alphabet_ptr->get_symbol(symbol_id).name;
-                } else {
-                    symbol_text = "?";
-                }
+    // Zoomable view, only the visible cells are drawn
+    m_canvas.draw("canvas", grid, m_render_cache);
 
-                ImVec2 text_size = ImGui::CalcTextSize(symbol_text.c_str());
-                ImVec2 text_pos(
-                    cell_min.x + (cell_size - text_size.x) * 0.5f,
-                    cell_min.y + (cell_size - text_size.y) * 0.5f
-                );
+    // Paint with the left mouse button, the others pan the view
+    paint();
 
-                draw_list->AddText(text_pos, IM_COL32(255, 255, 255, 255), symbol_text.c_str());
-            }
-        }
+    // The pattern preview follows the cursor
+    int hover_x, hover_y;
+    if (m_canvas.hovered_cell(hover_x, hover_y)) {
+        m_preview_x = hover_x;
+        m_preview_y = hover_y;
     }
 
-    // Allow interaction with the grid canvas
-    // Make sure the canvas size is never zero
-    ImVec2 safe_canvas_size = ImVec2(
-        std::max(1.0f, canvas_size.x),
-        std::max(1.0f, canvas_size.y)
-    );
-    ImGui::InvisibleButton("canvas", safe_canvas_size);
-
-    // Handle grid cell clicks (optional)
-    if (ImGui::IsItemHovered() && ImGui::IsMouseDown(0)) {
-        ImVec2 mouse_pos = ImGui::GetMousePos();
-        int grid_x = (int)((mouse_pos.x - canvas_pos.x) / cell_size);
-        int grid_y = (int)((mouse_pos.y - canvas_pos.y) / cell_size);
-
-        if (grid.in_bounds(grid_x, grid_y)) {
-            // Set cell to currently selected symbol
-            grid(grid_x, grid_y) = m_selected_symbol_id;
-        }
+    // A stroke becomes one undo step when the button is released
+    if (!ImGui::IsItemActive()) {
+        commit_stroke();
     }
 
     // Save dialog
@@ -701,13 +1023,10 @@ void editor::edit_synthesizer()
                 filename += ".json";
             }
 
-            // Save to file
+            // Save to file, errors are reported when the task finishes
             if (save_to_file(filename)) {
                 ImGui::CloseCurrentPopup();
                 m_show_save_dialog = false;
-            } else {
-                // Error handling could be improved
-                std::cerr << "Failed to save to file: " << filename << std::endl;
             }
         }
 
@@ -737,13 +1056,10 @@ void editor::edit_synthesizer()
                 filename += ".json";
             }
 
-            // Load from file
+            // Load from file, errors are reported when the task finishes
             if (load_from_file(filename)) {
                 ImGui::CloseCurrentPopup();
                 m_show_load_dialog = false;
-            } else {
-                // Error handling could be improved
-                std::cerr << "Failed to load from file: " << filename << std::endl;
             }
         }
 
@@ -763,112 +1079,410 @@ void editor::edit_synthesizer()
 // File operations
 bool editor::save_to_file(const std::string& filename)
 {
-    try {
-        // Get JSON representation of the grid_synth
-        nlohmann::json j = m_synth.to_json();
+    // Serialize a snapshot on the file thread, the document stays editable
+    auto snapshot = std::make_shared<grid_synth>(m_synth.clone());
+    auto error = std::make_shared<std::string>();
+    auto text_hash = std::make_shared<uint64_t>(0);
+    return m_file_task.start("Saving " + filename,
+        [snapshot, filename, error, text_hash](std::atomic<float>& progress) {
+            try {
+                // Write JSON with pretty formatting (4-space indentation)
+                std::string text = snapshot->to_json().dump(4);
+                *text_hash = hash_string(text);
+                progress = 0.5f;
+
+                std::ofstream file(filename);
+                if (!file.is_open()) {
+                    *error = "Could not open file for writing: " + filename;
+                    return;
+                }
+                for (size_t i = 0; i < text.size() && file; i += file_chunk_size) {
+                    file.write(text.data() + i, std::min(file_chunk_size, text.size() - i));
+                    progress = 0.5f + 0.5f * (float)std::min(i + file_chunk_size, text.size()) / text.size();
+                }
+                if (file.bad()) {
+                    *error = "Error writing to file: " + filename;
+                }
+            }
+            catch (const std::exception& e) {
+                *error = std::string("Error saving file: ") + e.what();
+            }
+        },
+        [this, filename, error, text_hash]() {
+            if (error->empty())
+                m_file_hash = *text_hash;
+            file_task_done(filename, *error);
+        });
+}
 
-        // Open file for writing
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Could not open file for writing: " << filename << std::endl;
-            return false;
-        }
+bool editor::load_from_file(const std::string& filename)
+{
+    // Read and parse on the file thread, the result is swapped in by
+    // the completion callback between two frames
+    auto loaded = std::make_shared<grid_synth>(0, 0);
+    auto error = std::make_shared<std::string>();
+    auto text_hash = std::make_shared<uint64_t>(0);
+    return m_file_task.start("Loading " + filename,
+        [loaded, filename, error, text_hash](std::atomic<float>& progress) {
+            try {
+                // Open file for reading
+                std::ifstream file(filename, std::ios::binary | std::ios::ate);
+                if (!file.is_open()) {
+                    *error = "Could not open file for reading: " + filename;
+                    return;
+                }
 
-        // Write JSON to file with pretty formatting (4-space indentation)
-        file << j.dump(4);
+                std::string text((size_t)file.tellg(), '\0');
+                file.seekg(0);
+                for (size_t i = 0; i < text.size() && file; i += file_chunk_size) {
+                    file.read(&text[i], std::min(file_chunk_size, text.size() - i));
+                    progress = 0.5f * (float)std::min(i + file_chunk_size, text.size()) / text.size();
+                }
 
-        // Check for errors
-        if (file.bad()) {
-            std::cerr << "Error writing to file: " << filename << std::endl;
-            return false;
-        }
+                *text_hash = hash_string(text);
 
-        return true;
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error saving file: " << e.what() << std::endl;
-        return false;
-    }
+                // Parse JSON from file
+                nlohmann::json j;
+                try {
+                    j = nlohmann::json::parse(text);
+                }
+                catch (const nlohmann::json::parse_error& e) {
+                    *error = std::string("JSON parse error: ") + e.what();
+                    return;
+                }
+                progress = 0.8f;
+
+                // Create grid_synth from JSON
+                *loaded = grid_synth::from_json(j);
+            }
+            catch (const std::exception& e) {
+                *error = std::string("Error loading file: ") + e.what();
+            }
+        },
+        [this, loaded, filename, error, text_hash]() {
+            if (error->empty()) {
+                m_file_hash = *text_hash;
+                m_reload_input = 0;
+                if (m_watcher.watching() && m_watcher.filename() != filename)
+                    m_watcher.watch(filename);
+                set_document(std::move(*loaded));
+            }
+            file_task_done(filename, *error);
+        });
 }
 
-bool editor::load_from_file(const std::string& filename)
+void editor::set_document(grid_synth synth)
 {
-    try {
-        // Open file for reading
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Could not open file for reading: " << filename << std::endl;
-            return false;
-        }
+    // A run of the previous document must not land on this one
+    stop_synthesis();
+    m_auto_fingerprint = 0;
+
+    m_synth = std::move(synth);
+    m_canvas.invalidate();
+    m_canvas.fit();
+    source_grid_changed();
+    m_stroke.clear();
+    m_history.clear();
+    m_history_pipeline = pipeline_state(m_synth);
+    m_selected_transform_index = -1; // Reset selection
+    m_editing_pattern = false;
+    m_current_rule = nullptr;
+}
 
-        // Parse JSON from file
-        nlohmann::json j;
-        try {
-            file >> j;
-        }
-        catch (const nlohmann::json::parse_error& e) {
-            std::cerr << "JSON parse error: " << e.what() << std::endl;
-            return false;
+void editor::new_document()
+{
+    focus_document(add_document());
+}
+
+size_t editor::add_document()
+{
+    document d;
+    d.id = m_next_document_id++;
+    d.synth = grid_synth(16, 16, alphabet::empty_symbol.id);
+    d.gallery = std::make_unique<variant_gallery>(m_renderer, m_pool);
+    d.history_pipeline = pipeline_state(d.synth);
+    m_documents.push_back(std::move(d));
+    return m_documents.size() - 1;
+}
+
+void editor::edit_documents()
+{
+    // A file task or dialog finishes on the document it started on
+    ImGui::BeginDisabled(m_file_task.busy() || m_pending_dialog);
+    if (ImGui::BeginTabBar("##Documents", ImGuiTabBarFlags_Reorderable)) {
+        for (size_t i = 0; i < m_documents.size(); ++i) {
+            const document& d = m_documents[i];
+            const bool active = i == m_active_document;
+            std::string label = active ? m_filename : d.filename;
+            label = label.empty() ? "Untitled" : label.substr(label.find_last_of("/\\") + 1);
+
+            // Background variants keep running, their progress shows on the tab
+            const variant_gallery* gallery = active ? m_gallery.get() : d.gallery.get();
+            if (gallery && gallery->busy())
+                label += " (" + std::to_string(gallery->done()) + "/" + std::to_string(gallery->size()) + ")";
+            label += "###document" + std::to_string(d.id);
+
+            bool open = true;
+            ImGuiTabItemFlags flags = active && m_select_tab ? ImGuiTabItemFlags_SetSelected : ImGuiTabItemFlags_None;
+            if (ImGui::BeginTabItem(label.c_str(), m_documents.size() > 1 ? &open : nullptr, flags)) {
+                if (!active && !m_select_tab)
+                    m_focus_request = i;
+                ImGui::EndTabItem();
+            }
+            if (!open)
+                m_close_request = i;
         }
+        m_select_tab = false;
 
-        // Create grid_synth from JSON
-        try {
-            // Use std::move to transfer ownership of the unique_ptrs
-            m_synth = std::move(grid_synth::from_json(j));
-            m_selected_transform_index = -1; // Reset selection
+        if (ImGui::TabItemButton("+", ImGuiTabItemFlags_Trailing)) {
+            m_focus_request = add_document();
         }
-        catch (const std::exception& e) {
-            std::cerr << "Error creating grid_synth from JSON: " << e.what() << std::endl;
-            return false;
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("New document");
         }
+        ImGui::EndTabBar();
+    }
+    ImGui::EndDisabled();
+}
 
-        return true;
+void editor::swap_document(document& d)
+{
+    std::swap(m_synth, d.synth);
+    std::swap(m_gallery, d.gallery);
+    std::swap(m_history, d.undo_history);
+    std::swap(m_history_pipeline, d.history_pipeline);
+    std::swap(m_file_hash, d.file_hash);
+    std::swap(m_reload_input, d.reload_input);
+    std::swap(m_auto_synthesize, d.auto_synthesize);
+    std::swap(m_source_grid, d.source_grid);
+    std::swap(m_auto_fingerprint, d.auto_fingerprint);
+    std::swap(m_lock_seed, d.lock_seed);
+    std::swap(m_selected_transform_index, d.selected_transform_index);
+
+    std::string filename = m_filename;
+    strncpy(m_filename, d.filename.c_str(), sizeof(m_filename) - 1);
+    m_filename[sizeof(m_filename) - 1] = '\0';
+    d.filename = std::move(filename);
+}
+
+void editor::focus_document(size_t index)
+{
+    if (index == m_active_document || index >= m_documents.size())
+        return;
+
+    // Finish the edits in flight, they belong to the document being parked
+    commit_stroke();
+    update_history();
+    m_painting = false;
+
+    // The worker only runs for the focused document. A cancelled auto run
+    // starts again when the document gets the focus back, from the stages
+    // it left in the stage cache.
+    if (stop_synthesis())
+        m_auto_fingerprint = 0;
+
+    m_documents[m_active_document].watch = m_watcher.watching();
+    swap_document(m_documents[m_active_document]);
+    m_active_document = index;
+    swap_document(m_documents[m_active_document]);
+    m_select_tab = true;
+
+    // Views of the previous document
+    m_canvas.invalidate();
+    m_canvas.fit();
+    m_match_overlay.invalidate();
+    for (auto& preview : m_stage_previews)
+        preview.valid = false;
+    m_stage_output_found = false;
+    m_stage_canvas.invalidate();
+    m_timeline.clear();
+    m_timeline_frame = 0;
+    m_timeline_canvas.invalidate();
+    m_editing_pattern = false;
+    m_current_rule = nullptr;
+    m_preview_key = 0;
+    m_preview_x = m_preview_y = -1;
+    m_file_status.clear();
+
+    m_reload_pending = false;
+    m_watch_status.clear();
+    if (m_documents[m_active_document].watch)
+        m_watcher.watch(m_filename);
+    else
+        m_watcher.stop();
+
+    m_gallery->focus();
+}
+
+void editor::close_document(size_t index)
+{
+    if (m_documents.size() < 2 || index >= m_documents.size())
+        return;
+
+    if (index == m_active_document)
+        focus_document(index + 1 < m_documents.size() ? index + 1 : index - 1);
+
+    // Destroying the gallery cancels its variants still in the pool
+    m_documents.erase(m_documents.begin() + index);
+    if (index < m_active_document)
+        m_active_document--;
+    m_select_tab = true;
+}
+
+void editor::file_task_done(const std::string& filename, const std::string& error)
+{
+    if (error.empty()) {
+        strncpy(m_filename, filename.c_str(), sizeof(m_filename) - 1);
+        m_file_status.clear();
+        return;
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error loading file: " << e.what() << std::endl;
-        return false;
+
+    std::cerr << error << std::endl;
+    m_file_status = error;
+#ifdef USE_PORTABLE_FILE_DIALOGS
+    try {
+        auto message = std::make_shared<pfd::message>("Error", error, pfd::choice::ok, pfd::icon::error);
+        m_pending_dialog = [message]() { return message->ready(0); };
+    } catch (const std::exception& e) {
+        std::cerr << "File dialog error: " << e.what() << std::endl;
     }
+#endif
+}
+
+void editor::open(const std::string& filename, bool watch)
+{
+    m_pending_opens.emplace_back(filename, watch);
+}
+
+void editor::set_watch(bool watch)
+{
+    m_reload_pending = false;
+    m_watch_status.clear();
+    if (!watch) {
+        m_watcher.stop();
+    } else if (!m_watcher.watch(m_filename)) {
+        m_watch_status = std::string("Could not watch ") + m_filename;
+    }
+}
+
+void editor::update_watch()
+{
+    if (m_watcher.changed())
+        m_reload_pending = true;
+    if (!m_reload_pending || m_file_task.busy())
+        return;
+    m_reload_pending = false;
+
+    // Read and parse off the UI thread like a load, but only the pipeline is
+    // taken over, the grid of the file becomes the input of a resynthesis
+    const std::string filename = m_watcher.filename();
+    const uint64_t known_hash = m_file_hash;
+    auto loaded = std::make_shared<grid_synth>(0, 0);
+    auto error = std::make_shared<std::string>();
+    auto text_hash = std::make_shared<uint64_t>(0);
+    m_file_task.start("Reloading " + filename,
+        [loaded, filename, known_hash, error, text_hash](std::atomic<float>&) {
+            try {
+                std::ifstream file(filename, std::ios::binary);
+                if (!file.is_open()) {
+                    *error = "Could not open file for reading: " + filename;
+                    return;
+                }
+                std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                *text_hash = hash_string(text);
+                if (*text_hash == known_hash)
+                    return;
+                *loaded = grid_synth::from_json(nlohmann::json::parse(text));
+            }
+            catch (const std::exception& e) {
+                *error = std::string("Error reloading file: ") + e.what();
+            }
+        },
+        [this, loaded, error, text_hash]() {
+            if (!error->empty()) {
+                // Often a half-written file, the next change reloads it again
+                m_watch_status = *error;
+                return;
+            }
+            if (*text_hash == m_file_hash)
+                return;
+            m_file_hash = *text_hash;
+            apply_reload(*loaded);
+        });
+}
+
+void editor::apply_reload(grid_synth& loaded)
+{
+    const grid& input = loaded.get_grid();
+    const uint64_t input_hash = hash_bytes(input.raw_data(), (size_t)input.width() * input.height() * sizeof(int),
+                                           hash_combine(input.width(), input.height()));
+    const size_t first = loaded.first_changed_stage(m_synth);
+    const size_t stages = loaded.get_transformations().size();
+    if (first >= std::max(stages, m_synth.get_transformations().size()) && input_hash == m_reload_input) {
+        m_watch_status = "Reloaded, nothing changed";
+        return;
+    }
+    m_reload_input = input_hash;
+
+    // The reload is recorded by update_history() like any pipeline edit
+    m_synth.load_pipeline(loaded.pipeline_to_json());
+    m_editing_pattern = false;
+    m_current_rule = nullptr;
+    if (m_selected_transform_index >= (int)m_synth.get_transformations().size())
+        m_selected_transform_index = -1;
+
+    grid_synth job = m_synth.clone();
+    job.get_grid() = std::move(loaded.get_grid());
+    if (m_auto_synthesize) {
+        m_source_grid = job.get_grid();
+        m_auto_fingerprint = hash_string(m_synth.pipeline_to_json().dump());
+        m_auto_deadline = -1.0;
+    }
+    m_worker.start(std::move(job), nullptr, &m_stage_cache);
+
+    if (first < stages)
+        m_watch_status = "Reloaded, pipeline changed from stage " + std::to_string(first + 1);
+    else
+        m_watch_status = "Reloaded";
 }
 
 void editor::show_file_dialog(bool isSave)
 {
 #ifdef USE_PORTABLE_FILE_DIALOGS
-    // Use Portable File Dialogs library
+    // Use Portable File Dialogs library, polled every frame instead of
+    // waiting for the result so the UI keeps running
     try {
         // Set up the file dialog options
         std::vector<std::string> filters = { "JSON Files", "*.json", "All Files", "*.*" };
 
         if (isSave) {
             // Show save dialog
-            auto selection = pfd::save_file("Save Grid Synth", "", filters).result();
-            if (!selection.empty()) {
-                std::string filename = selection;
-                // Ensure the filename has .json extension
-                if (filename.find(".json") == std::string::npos) {
-                    filename += ".json";
-                }
-
-                if (save_to_file(filename)) {
-                    // Success - nothing more to do
-                    strncpy(m_filename, filename.c_str(), sizeof(m_filename) - 1);
-                } else {
-                    // Show error message
-                    pfd::message("Error", "Failed to save file", pfd::choice::ok, pfd::icon::error);
+            auto dialog = std::make_shared<pfd::save_file>("Save Grid Synth", "", filters);
+            m_pending_dialog = [this, dialog]() {
+                if (!dialog->ready(0))
+                    return false;
+                std::string filename = dialog->result();
+                if (!filename.empty()) {
+                    // Ensure the filename has .json extension
+                    if (filename.find(".json") == std::string::npos) {
+                        filename += ".json";
+                    }
+                    save_to_file(filename);
                 }
-            }
+                return true;
+            };
         } else {
             // Show open dialog
-            auto selection = pfd::open_file("Open Grid Synth", "", filters).result();
-            if (!selection.empty() && !selection[0].empty()) {
-                std::string filename = selection[0];
-                if (load_from_file(filename)) {
-                    // Success - nothing more to do
-                    strncpy(m_filename, filename.c_str(), sizeof(m_filename) - 1);
-                } else {
-                    // Show error message
-                    pfd::message("Error", "Failed to load file", pfd::choice::ok, pfd::icon::error);
+            auto dialog = std::make_shared<pfd::open_file>("Open Grid Synth", "", filters);
+            m_pending_dialog = [this, dialog]() {
+                if (!dialog->ready(0))
+                    return false;
+                auto selection = dialog->result();
+                if (!selection.empty() && !selection[0].empty()) {
+                    load_from_file(selection[0]);
                 }
-            }
+                return true;
+            };
         }
     } catch (const std::exception& e) {
         std::cerr << "File dialog error: " << e.what() << std::endl;
@@ -887,4 +1501,480 @@ void editor::show_file_dialog(bool isSave)
         m_show_load_dialog = true;
     }
 #endif
-}
\ No newline at end of file
+}
+
+void editor::start_synthesis()
+{
+    // Run on a snapshot so the UI stays responsive and editable
+    grid_synth job = m_synth.clone();
+    if (m_auto_synthesize) {
+        job.get_grid() = m_source_grid;
+        m_auto_fingerprint = hash_string(m_synth.pipeline_to_json().dump());
+        m_auto_deadline = -1.0;
+    }
+    m_worker.start(std::move(job), &m_cache, &m_stage_cache);
+}
+
+bool editor::stop_synthesis()
+{
+    const bool pending = m_worker.busy() || m_worker.has_result() || m_auto_deadline >= 0.0;
+    m_worker.cancel();
+    m_worker.take_result(m_result);
+    m_auto_deadline = -1.0;
+    return pending;
+}
+
+void editor::update_auto_synthesis()
+{
+    // Any edit to the alphabet, stack, patterns or seed changes the pipeline JSON
+    uint64_t fingerprint = hash_string(m_synth.pipeline_to_json().dump());
+    if (fingerprint != m_auto_fingerprint) {
+        m_auto_fingerprint = fingerprint;
+        m_auto_deadline = ImGui::GetTime() + auto_synthesize_delay;
+        m_worker.cancel();
+    }
+
+    if (m_auto_deadline >= 0.0 && ImGui::GetTime() >= m_auto_deadline) {
+        grid_synth job = m_synth.clone();
+        job.get_grid() = m_source_grid;
+        m_auto_deadline = -1.0;
+        // Stage outputs are reused, but quick iterations are not worth a disk entry each
+        m_worker.start(std::move(job), nullptr, &m_stage_cache);
+    }
+}
+
+void editor::source_grid_changed()
+{
+    if (m_auto_synthesize) {
+        m_source_grid = m_synth.get_grid();
+        m_auto_fingerprint = 0;
+    }
+}
+
+void editor::update_stage_previews(const std::vector<stage_thumbnail>& thumbnails)
+{
+    for (auto& preview : m_stage_previews)
+        preview.valid = false;
+
+    for (const auto& thumbnail : thumbnails) {
+        if (thumbnail.index >= m_stage_previews.size())
+            m_stage_previews.resize(thumbnail.index + 1);
+        stage_preview& preview = m_stage_previews[thumbnail.index];
+        preview.valid = true;
+        preview.width = thumbnail.image.width();
+        preview.height = thumbnail.image.height();
+
+        // Only upload thumbnails whose stage output changed
+        if (!preview.texture)
+            preview.texture = std::make_unique<grid_texture>(m_renderer);
+        else if (preview.key == thumbnail.key)
+            continue;
+        preview.key = thumbnail.key;
+        preview.texture->invalidate();
+        preview.texture->update(thumbnail.image);
+    }
+}
+
+void editor::show_stage_output(size_t index)
+{
+    // Full outputs are kept by the stage cache until they are evicted
+    m_show_stage_output = true;
+    m_stage_output_index = index;
+    m_stage_output_found = index < m_stage_previews.size() &&
+                           m_stage_previews[index].valid &&
+                           m_stage_cache.find(m_stage_previews[index].key, m_stage_output);
+    m_stage_canvas.invalidate();
+    m_stage_canvas.fit();
+}
+
+void editor::edit_stage_output()
+{
+    if (!m_show_stage_output)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Stage Output", &m_show_stage_output)) {
+        ImGui::End();
+        return;
+    }
+
+    const auto& transformations = m_synth.get_transformations();
+    if (m_stage_output_index < transformations.size())
+        ImGui::Text("%zu. %s", m_stage_output_index + 1, transformations[m_stage_output_index]->name().c_str());
+
+    if (m_stage_output_found) {
+        ImGui::SameLine();
+        if (ImGui::Button("Fit")) {
+            m_stage_canvas.fit();
+        }
+        m_stage_canvas.draw("##StageOutput", m_stage_output, m_render_cache);
+    } else {
+        ImGui::TextWrapped("The output of this stage is no longer cached, synthesize again to see it.");
+    }
+
+    ImGui::End();
+}
+
+void editor::edit_minimap()
+{
+    if (!m_show_minimap)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(220, 240), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Minimap", &m_show_minimap)) {
+        // Drawn from the pyramid of the grid canvas, updated by its last draw
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        draw_minimap("minimap", m_canvas, m_synth.get_grid(), m_render_cache, std::max(16.0f, std::min(avail.x, avail.y)));
+    }
+    ImGui::End();
+}
+
+void editor::edit_timeline()
+{
+    if (!m_show_timeline)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(400, 450), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Timeline", &m_show_timeline)) {
+        ImGui::End();
+        return;
+    }
+
+    if (m_timeline.size() == 0) {
+        ImGui::TextWrapped("Synthesize to record the input and the output of every stage.");
+        ImGui::End();
+        if (!m_show_timeline)
+            m_worker.set_timeline_budget(0);
+        return;
+    }
+
+    // Scrubbing reconstructs frames from keyframes and diffs, nothing is rerun
+    const int last = (int)m_timeline.size() - 1;
+    int frame = std::clamp(m_timeline_frame, 0, last);
+    ImGui::BeginDisabled(frame == 0);
+    if (ImGui::Button("<")) {
+        frame--;
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled(frame == last);
+    if (ImGui::Button(">")) {
+        frame++;
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1);
+    ImGui::SliderInt("##Frame", &frame, 0, last, m_timeline.label(frame).c_str());
+    if (frame != m_timeline_frame) {
+        m_timeline_frame = frame;
+        m_timeline_canvas.invalidate();
+    }
+
+    ImGui::TextDisabled("%d / %d, %.1f MB, %zu frames dropped to fit the budget",
+                        frame, last, m_timeline.bytes() / (1024.0 * 1024.0), m_timeline.dropped());
+    m_timeline_canvas.draw("##TimelineCanvas", m_timeline.seek(frame), m_render_cache);
+
+    ImGui::End();
+
+    if (!m_show_timeline)
+        m_worker.set_timeline_budget(0);
+}
+
+void editor::edit_gallery()
+{
+    if (!m_show_gallery) {
+        if (m_gallery->busy())
+            m_gallery->cancel();
+        return;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(480, 400), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Variants", &m_show_gallery)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::SetNextItemWidth(120);
+    ImGui::SliderInt("Seeds", &m_gallery_count, 4, 64);
+    ImGui::SameLine();
+    if (ImGui::Button("Generate")) {
+        // Same input as the Synthesize button, with distinct random seeds
+        grid_synth job = m_synth.clone();
+        if (m_auto_synthesize)
+            job.get_grid() = m_source_grid;
+
+        std::random_device rd;
+        std::vector<uint32_t> seeds;
+        while ((int)seeds.size() < m_gallery_count) {
+            uint32_t seed = rd();
+            if (std::find(seeds.begin(), seeds.end(), seed) == seeds.end())
+                seeds.push_back(seed);
+        }
+        m_gallery->start(std::move(job), std::move(seeds), &m_cache, &m_stage_cache);
+    }
+    if (m_gallery->busy()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar((float)m_gallery->done() / std::max<size_t>(1, m_gallery->size()), ImVec2(100, 0));
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            m_gallery->cancel();
+        }
+    }
+    ImGui::Separator();
+
+    // Adopting a seed locks it, the run hits the result cache
+    uint32_t seed;
+    if (m_gallery->draw(seed)) {
+        m_synth.set_seed(seed);
+        m_lock_seed = true;
+        if (!m_auto_synthesize)
+            start_synthesis();
+    }
+
+    ImGui::End();
+}
+
+void editor::paint()
+{
+    // Cell under the mouse, also outside the grid so strokes leaving it
+    // still reach the edge
+    const ImVec2 mouse = m_canvas.screen_to_grid(ImGui::GetIO().MousePos);
+    const int x = (int)std::floor(mouse.x);
+    const int y = (int)std::floor(mouse.y);
+    const bool pressed = ImGui::IsItemActive() && ImGui::IsMouseDown(ImGuiMouseButton_Left);
+    const bool started = pressed && !m_painting;
+    const bool released = !pressed && m_painting;
+    m_painting = pressed;
+
+    auto& g = m_synth.get_grid();
+    paint_batch batch;
+    switch (m_paint_tool) {
+    case paint_tool::brush:
+        // Connect to the cell of the previous frame so fast strokes leave no gaps
+        if (pressed) {
+            if (started)
+                paint_disc(g, x, y, m_brush_radius, m_selected_symbol_id, batch);
+            else
+                paint_line(g, m_paint_x, m_paint_y, x, y, m_brush_radius, m_selected_symbol_id, batch);
+            m_paint_x = x;
+            m_paint_y = y;
+        }
+        break;
+
+    case paint_tool::line:
+        if (started) {
+            m_paint_x = x;
+            m_paint_y = y;
+        }
+        if (pressed) {
+            const float width = std::max(1.0f, (2 * m_brush_radius + 1) * m_canvas.zoom());
+            ImGui::GetWindowDrawList()->AddLine(
+                m_canvas.grid_to_screen(ImVec2(m_paint_x + 0.5f, m_paint_y + 0.5f)),
+                m_canvas.grid_to_screen(ImVec2(x + 0.5f, y + 0.5f)),
+                (m_render_cache.get(m_selected_symbol_id).color & 0x00FFFFFF) | 0x80000000, width);
+        }
+        if (released)
+            paint_line(g, m_paint_x, m_paint_y, x, y, m_brush_radius, m_selected_symbol_id, batch);
+        break;
+
+    case paint_tool::fill:
+        if (started)
+            flood_fill(g, x, y, m_selected_symbol_id, batch);
+        break;
+    }
+
+    if (batch.empty())
+        return;
+    m_stroke.insert(m_stroke.end(), batch.old_cells.begin(), batch.old_cells.end());
+    m_canvas.invalidate_region(batch.x0, batch.y0, batch.x1, batch.y1);
+    if (m_paint_tool != paint_tool::brush)
+        commit_stroke(m_paint_tool == paint_tool::line ? "Line" : "Fill");
+}
+
+void editor::commit_stroke(const char* label)
+{
+    if (m_stroke.empty())
+        return;
+    history::entry e;
+    e.label = label;
+    e.grid_change = grid_diff::from_cells(m_synth.get_grid(), std::move(m_stroke));
+    m_stroke.clear();
+    if (!e.grid_change.empty())
+        m_history.push(std::move(e));
+}
+
+void editor::record_grid_change(const char* label, const grid& before)
+{
+    history::entry e;
+    e.label = label;
+    e.grid_change = grid_diff::between(before, m_synth.get_grid());
+    if (!e.grid_change.empty())
+        m_history.push(std::move(e));
+}
+
+void editor::update_history()
+{
+    // Wait until drags and text edits are finished so they become one step
+    if (ImGui::IsAnyItemActive())
+        return;
+
+    std::string state = pipeline_state(m_synth);
+    if (state != m_history_pipeline) {
+        history::entry e;
+        e.label = "Edit pipeline";
+        e.pipeline_before = std::move(m_history_pipeline);
+        e.pipeline_after = state;
+        m_history.push(std::move(e));
+        m_history_pipeline = std::move(state);
+    }
+}
+
+void editor::undo()
+{
+    commit_stroke();
+    update_history();
+    if (const history::entry* e = m_history.undo())
+        apply_history(*e, false);
+}
+
+void editor::redo()
+{
+    commit_stroke();
+    if (const history::entry* e = m_history.redo())
+        apply_history(*e, true);
+}
+
+void editor::apply_history(const history::entry& e, bool forward)
+{
+    if (!e.grid_change.empty()) {
+        e.grid_change.apply(m_synth.get_grid(), forward);
+        m_canvas.invalidate();
+    }
+
+    const std::string& state = forward ? e.pipeline_after : e.pipeline_before;
+    if (!state.empty()) {
+        try {
+            nlohmann::json j = nlohmann::json::parse(state);
+            j["seed"] = m_synth.seed();
+            m_synth.load_pipeline(j);
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "Error restoring pipeline: " << ex.what() << std::endl;
+        }
+
+        // Transformations were recreated, drop references to the old ones
+        m_editing_pattern = false;
+        m_current_rule = nullptr;
+        if (m_selected_transform_index >= (int)m_synth.get_transformations().size())
+            m_selected_transform_index = -1;
+        m_history_pipeline = pipeline_state(m_synth);
+    }
+}
+
+void editor::show_export_dialog()
+{
+#ifdef USE_PORTABLE_FILE_DIALOGS
+    try {
+        std::vector<std::string> filters = { "PNG Images", "*.png", "PPM Images", "*.ppm",
+                                             "Tiled Maps", "*.tmx", "CSV Files", "*.csv" };
+        auto dialog = std::make_shared<pfd::save_file>("Export", "", filters);
+        m_pending_dialog = [this, dialog]() {
+            if (!dialog->ready(0))
+                return false;
+            std::string filename = dialog->result();
+            if (!filename.empty())
+                export_to_file(filename);
+            return true;
+        };
+    } catch (const std::exception& e) {
+        std::cerr << "File dialog error: " << e.what() << std::endl;
+    }
+#else
+    if (m_filename[0] != '\0')
+        export_to_file(m_filename);
+#endif
+}
+
+bool editor::export_to_file(std::string filename)
+{
+    // Tilemaps for game engines, with one tile per alphabet symbol
+    const bool tilemap = filename.find(".tmx") != std::string::npos || filename.find(".csv") != std::string::npos;
+
+    // Default to PNG when no known extension was given
+    if (!tilemap && filename.find(".png") == std::string::npos && filename.find(".ppm") == std::string::npos) {
+        filename += ".png";
+    }
+
+    // Encode a copy of the grid on the file thread
+    auto snapshot = std::make_shared<grid>(m_synth.get_grid());
+    auto mapping = std::make_shared<tile_mapping>(tile_mapping::from_alphabet(*m_synth.get_alphabet()));
+    auto p = std::make_shared<palette>(palette::from_alphabet(*m_synth.get_alphabet()));
+    auto error = std::make_shared<std::string>();
+    return m_file_task.start("Exporting " + filename,
+        [snapshot, mapping, p, filename, tilemap, error](std::atomic<float>&) {
+            if (tilemap) {
+                tilemap_options options;
+                options.format = tilemap_format_from_filename(filename);
+                if (!save_tilemap(filename, *snapshot, *mapping, options))
+                    *error = "Failed to export tilemap: " + filename;
+            } else if (!save_image(filename, *snapshot, *p)) {
+                *error = "Failed to export image: " + filename;
+            }
+        },
+        [this, error]() {
+            if (!error->empty())
+                file_task_done(m_filename, *error);
+        });
+}
+
+void editor::show_import_dialog()
+{
+#ifdef USE_PORTABLE_FILE_DIALOGS
+    try {
+        std::vector<std::string> filters = { "Images", "*.png *.ppm", "All Files", "*.*" };
+        auto dialog = std::make_shared<pfd::open_file>("Import Image", "", filters);
+        m_pending_dialog = [this, dialog]() {
+            if (!dialog->ready(0))
+                return false;
+            auto selection = dialog->result();
+            if (!selection.empty() && !selection[0].empty())
+                import_from_file(selection[0]);
+            return true;
+        };
+    } catch (const std::exception& e) {
+        std::cerr << "File dialog error: " << e.what() << std::endl;
+    }
+#else
+    if (m_filename[0] != '\0')
+        import_from_file(m_filename);
+#endif
+}
+
+bool editor::import_from_file(const std::string& filename)
+{
+    // Colors map back to symbols through the same palette the exporter uses
+    auto p = std::make_shared<palette>(palette::from_alphabet(*m_synth.get_alphabet()));
+    auto imported = std::make_shared<grid>();
+    auto error = std::make_shared<std::string>();
+    return m_file_task.start("Importing " + filename,
+        [p, imported, filename, error](std::atomic<float>&) {
+            if (!load_image(filename, *imported, *p))
+                *error = "Failed to import image: " + filename;
+        },
+        [this, imported, error]() {
+            if (!error->empty()) {
+                file_task_done(m_filename, *error);
+                return;
+            }
+            // A run started before the import would overwrite the imported grid
+            stop_synthesis();
+            m_auto_fingerprint = 0;
+
+            grid before = std::move(m_synth.get_grid());
+            m_synth.get_grid() = std::move(*imported);
+            record_grid_change("Import", before);
+            m_canvas.invalidate();
+            m_canvas.fit();
+            source_grid_changed();
+        });
+}
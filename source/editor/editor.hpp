@@ -1,6 +1,19 @@
 #pragma once
 
+#include "core/background_task.hpp"
+#include "core/file_watcher.hpp"
 #include "core/grid_synth.hpp"
+#include "core/result_cache.hpp"
+#include "core/synthesis_pool.hpp"
+#include "core/synthesis_worker.hpp"
+#include "core/stage_cache.hpp"
+#include "grid_canvas.hpp"
+#include "render_cache.hpp"
+#include "history.hpp"
+#include "perf_panel.hpp"
+#include "variant_gallery.hpp"
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace gs
@@ -9,13 +22,16 @@ namespace gs
 /// @brief Editor class for Grid Synth
 ///
 /// Provides interactive UI for editing the grid, alphabet, and transformations.
-/// Handles visualization, user input, and file operations.
+/// Handles visualization, user input, and file operations. Several documents
+/// can be open as tabs, they share the caches and the synthesis pool.
 class editor
 {
 public:
     /// @brief Constructor
     /// Initializes the editor with a default grid and some sample transformations.
-    editor();
+    /// @param renderer SDL renderer used for grid textures, the grid is drawn
+    ///        with rectangles when null
+    explicit editor(SDL_Renderer* renderer = nullptr);
 
     /// @brief Destructor
     ~editor() = default;
@@ -24,6 +40,22 @@ public:
     /// Renders all editor components and processes user input.
     void edit();
 
+    /// @brief Check if the editor needs frames without user input
+    /// @return True while a synthesis is scheduled, running or waiting to be
+    ///         shown, or variants of any document are being generated
+    bool wants_continuous_update() const;
+
+    /// @brief Load a project in a new tab, or in the focused one while it is
+    /// untouched. Projects are loaded one after the other, starting with the
+    /// next frame.
+    /// @param filename Path to the JSON file
+    /// @param watch Whether to reload the project whenever the file changes
+    void open(const std::string& filename, bool watch);
+
+    /// @brief Replace the document, clearing the undo history
+    /// @param synth The new grid and pipeline
+    void set_document(grid_synth synth);
+
 private:
     // UI components
     /// @brief Edit the alphabet (symbols)
@@ -47,25 +79,331 @@ private:
     /// @param transform Pointer to the rule-based transformation to edit
     void edit_rule_based_transformation(rule_based_transformation* transform);
 
+    /// @brief Show the rule being edited applied to the grid around the
+    /// last cell hovered on the canvas, recomputed when the pattern changes
+    void edit_pattern_preview();
+
     // File operations
-    /// @brief Save grid synth to a JSON file
+    /// @brief Save a snapshot of the grid synth to a JSON file in the background
     /// @param filename Path to the file
-    /// @return True if save was successful, false otherwise
+    /// @return True if the save started, false if another file task is running
     bool save_to_file(const std::string& filename);
 
-    /// @brief Load grid synth from a JSON file
+    /// @brief Load grid synth from a JSON file in the background, it replaces
+    /// the document between two frames once it is parsed
     /// @param filename Path to the file
-    /// @return True if load was successful, false otherwise
+    /// @return True if the load started, false if another file task is running
     bool load_from_file(const std::string& filename);
 
+    /// @brief Finish a file task on the UI thread, reporting its error if any
+    /// @param filename Path of the file
+    /// @param error Error message, empty on success
+    void file_task_done(const std::string& filename, const std::string& error);
+
+    /// @brief Watch the current file, or stop watching it
+    /// @param watch Whether to watch
+    void set_watch(bool watch);
+
+    /// @brief Parse the watched file in the background when it changed
+    void update_watch();
+
+    /// @brief Take over the pipeline of a reloaded file and resynthesize it
+    /// from its grid, the stage cache skips the unchanged leading stages
+    /// @param loaded The parsed file
+    void apply_reload(grid_synth& loaded);
+
     /// @brief Show file dialog
     /// @param isSave True for save dialog, false for load dialog
     void show_file_dialog(bool isSave);
 
+    /// @brief Show an open dialog and replace the grid with a PNG or PPM image
+    void show_import_dialog();
+
+    /// @brief Show a save dialog and export the grid as a PNG or PPM image
+    void show_export_dialog();
+
+    /// @brief Replace the grid with an image decoded in the background
+    /// @param filename Path to the image
+    /// @return True if the import started
+    bool import_from_file(const std::string& filename);
+
+    /// @brief Export a copy of the grid as an image or tilemap in the background
+    /// @param filename Path to the file, .png is added without a known extension
+    /// @return True if the export started
+    bool export_to_file(std::string filename);
+
+    // Synthesis
+    /// @brief Start synthesizing a snapshot of the pipeline on the worker
+    void start_synthesis();
+
+    /// @brief Cancel the worker, drop its result and the scheduled auto run
+    /// @return True if a run was in flight, finished or scheduled
+    bool stop_synthesis();
+
+    /// @brief Schedule a debounced run when the pipeline changed, and start it when due
+    void update_auto_synthesis();
+
+    /// @brief Take the current grid as the input of auto synthesis runs
+    void source_grid_changed();
+
+    // Stage previews
+    /// @brief Upload the thumbnails of a synthesis result that changed
+    /// @param thumbnails Thumbnails of the result, empty on a result cache hit
+    void update_stage_previews(const std::vector<stage_thumbnail>& thumbnails);
+
+    /// @brief Open the full output of a stage in the Stage Output window
+    /// @param index Transformation index of the stage
+    void show_stage_output(size_t index);
+
+    /// @brief Draw the Stage Output window
+    void edit_stage_output();
+
+    /// @brief Draw the Timeline window
+    void edit_timeline();
+
+    /// @brief Draw the Minimap window, navigating the grid canvas
+    void edit_minimap();
+
+    /// @brief Draw the Variants window
+    void edit_gallery();
+
+    // Documents
+    /// @brief Open an empty document in a new tab and give it the focus
+    void new_document();
+
+    /// @brief Per-document state, held by the editor members while the
+    /// document has the focus and parked here while it is in the background
+    struct document {
+        int id = 0;                             ///< Identifies the tab, stays with the slot
+        bool watch = false;                     ///< Whether its file is watched, stays with the slot
+        grid_synth synth{0, 0};
+        std::unique_ptr<variant_gallery> gallery;
+        history undo_history;
+        std::string history_pipeline;
+        std::string filename;
+        uint64_t file_hash = 0;
+        uint64_t reload_input = 0;
+        bool auto_synthesize = false;
+        grid source_grid{0, 0};
+        uint64_t auto_fingerprint = 0;
+        bool lock_seed = false;
+        int selected_transform_index = -1;
+    };
+
+    /// @brief Add an empty document in the background
+    /// @return Index of the document in m_documents
+    size_t add_document();
+
+    /// @brief Draw the document tabs, switching and closing happen at the
+    /// start of the next frame
+    void edit_documents();
+
+    /// @brief Exchange the state of the focused document with a parked one
+    /// @param d The parked document, receives the focused one
+    void swap_document(document& d);
+
+    /// @brief Park the focused document and bring another one forward
+    /// @param index Index of the document in m_documents
+    void focus_document(size_t index);
+
+    /// @brief Close a document, the last one stays open
+    /// @param index Index of the document in m_documents
+    void close_document(size_t index);
+
+    // History
+    /// @brief Turn the cells painted since the last call into an undo step
+    /// @param label Description of the step
+    void commit_stroke(const char* label = "Paint");
+
+    /// @brief Paint on the grid canvas with the current tool
+    ///
+    /// All writes of a frame end up in one region reported to the canvas,
+    /// which passes it on to the textures and the match overlay.
+    void paint();
+
+    /// @brief Add an undo step for a change of the whole grid
+    /// @param label Description of the change
+    /// @param before The grid before the change
+    void record_grid_change(const char* label, const grid& before);
+
+    /// @brief Add an undo step if the pipeline changed since the last one
+    void update_history();
+
+    /// @brief Revert the last step
+    void undo();
+
+    /// @brief Reapply the last reverted step
+    void redo();
+
+    /// @brief Apply or revert a step
+    /// @param e The step
+    /// @param forward True to reapply, false to revert
+    void apply_history(const history::entry& e, bool forward);
+
     // Core synthesizer data
     /// @brief The main grid synthesis object
     grid_synth m_synth;
 
+    /// @brief On-disk cache of synthesized grids
+    result_cache m_cache;
+
+    /// @brief Outputs of recently run stages, so edits only rerun the changed suffix
+    stage_cache m_stage_cache;
+
+    /// @brief Background thread running the synthesis of the focused
+    /// document, declared after the caches it uses so it is stopped before
+    /// they go away
+    synthesis_worker m_worker;
+
+    /// @brief Threads running the variants of all documents, those of the
+    /// focused document first, declared after the caches they use
+    synthesis_pool m_pool;
+
+    /// @brief Thumbnails of the pipeline synthesized with many seeds, declared
+    /// after the pool that runs them
+    std::unique_ptr<variant_gallery> m_gallery;
+
+    /// @brief Open documents in tab order, the slot of the focused one is
+    /// empty since its state is held by the editor members
+    std::vector<document> m_documents;
+
+    /// @brief Index of the focused document
+    size_t m_active_document = 0;
+
+    /// @brief Id given to the next new document
+    int m_next_document_id = 1;
+
+    /// @brief Tab selected or closed during the last frame, applied at the
+    /// start of the next one, SIZE_MAX if none
+    size_t m_focus_request = SIZE_MAX;
+    size_t m_close_request = SIZE_MAX;
+
+    /// @brief Projects waiting to be opened, with whether to watch them
+    std::vector<std::pair<std::string, bool>> m_pending_opens;
+
+    /// @brief Whether the tab bar has to select the focused tab, after a
+    /// switch it did not make itself
+    bool m_select_tab = false;
+
+    /// @brief Whether the Variants window is open
+    bool m_show_gallery = false;
+
+    /// @brief Number of seeds the gallery runs
+    int m_gallery_count = 16;
+
+    /// @brief Last result of the worker, its grid is recycled for the next one
+    batch_result m_result{0, grid(0, 0), 0.0, false};
+
+    /// @brief Whether to resynthesize automatically after edits
+    bool m_auto_synthesize = false;
+
+    /// @brief Input grid of auto synthesis runs
+    grid m_source_grid{0, 0};
+
+    /// @brief Hash of the pipeline the last auto run was scheduled for
+    uint64_t m_auto_fingerprint = 0;
+
+    /// @brief Time at which the scheduled auto run starts, negative if none
+    double m_auto_deadline = -1.0;
+
+    /// @brief Whether to keep the seed between runs instead of rolling a new one
+    bool m_lock_seed = false;
+
+    /// @brief Whether the last synthesis was served from the cache
+    bool m_last_cache_hit = false;
+
+    /// @brief Where the search pattern of the selected rule matches the grid,
+    /// declared before the canvas that draws it
+    match_overlay m_match_overlay;
+
+    /// @brief Whether to show the match overlay
+    bool m_show_matches = true;
+
+    /// @brief Zoomable view of the grid in the Synthesizer window
+    grid_canvas m_canvas;
+
+    /// @brief Renderer the textures are created with, may be null
+    SDL_Renderer* m_renderer;
+
+    /// @brief Thumbnail of a stage output in the Transformation Stack window
+    struct stage_preview {
+        uint64_t key = 0;                       ///< Stage key of the uploaded thumbnail
+        bool valid = false;                     ///< Whether it belongs to the last result
+        int width = 0;
+        int height = 0;
+        std::unique_ptr<grid_texture> texture;
+    };
+
+    /// @brief Whether the worker makes stage thumbnails
+    bool m_show_stage_previews = false;
+
+    /// @brief Thumbnails by transformation index
+    std::vector<stage_preview> m_stage_previews;
+
+    /// @brief Whether the Stage Output window is open
+    bool m_show_stage_output = false;
+
+    /// @brief Transformation index shown in the Stage Output window
+    size_t m_stage_output_index = 0;
+
+    /// @brief Whether m_stage_output holds the output of that stage
+    bool m_stage_output_found = false;
+
+    /// @brief Full output of the stage shown in the Stage Output window
+    grid m_stage_output{0, 0};
+
+    /// @brief View of m_stage_output
+    grid_canvas m_stage_canvas;
+
+    /// @brief Whether the Timeline window is open and the worker records timelines
+    bool m_show_timeline = false;
+
+    /// @brief Whether the Minimap window is open
+    bool m_show_minimap = false;
+
+    /// @brief Recording of the last synthesis
+    synthesis_timeline m_timeline;
+
+    /// @brief Frame of the timeline shown in the Timeline window
+    int m_timeline_frame = 0;
+
+    /// @brief View of the timeline frame
+    grid_canvas m_timeline_canvas;
+
+    /// @brief Undo and redo steps
+    history m_history;
+
+    /// @brief Pipeline JSON as of the last undo step
+    std::string m_history_pipeline;
+
+    /// @brief Index and previous value of the cells painted in the current stroke
+    std::vector<std::pair<uint32_t, int>> m_stroke;
+
+    /// @brief Painting tools of the grid canvas
+    enum class paint_tool { brush, line, fill };
+
+    /// @brief Current painting tool
+    paint_tool m_paint_tool = paint_tool::brush;
+
+    /// @brief Radius of the brush and lines in cells, 0 for single cells
+    int m_brush_radius = 0;
+
+    /// @brief Whether the left button went down on the canvas and is still held
+    bool m_painting = false;
+
+    /// @brief Cell of the previous frame of a brush stroke, or the start of a line
+    int m_paint_x = 0;
+    int m_paint_y = 0;
+
+    /// @brief Colors and labels of the symbols for the grid canvases
+    render_cache m_render_cache;
+
+    /// @brief Frame timings, synthesis profile and memory use
+    perf_panel m_perf;
+
+    /// @brief Whether the performance panel is open
+    bool m_show_perf = false;
+
     // UI state for transformations
     /// @brief Index of the currently selected transformation
     int m_selected_transform_index = -1;
@@ -86,6 +424,21 @@ private:
     /// @brief Working copy of the pattern being edited
     grid m_pattern_grid;
 
+    /// @brief Center of the pattern preview, the last cell hovered on the canvas
+    int m_preview_x = -1;
+    int m_preview_y = -1;
+
+    /// @brief Region of the grid around the preview center, and the same
+    /// region with the rule being edited applied
+    grid m_preview_before{0, 0};
+    grid m_preview_after{0, 0};
+
+    /// @brief Hash of the pattern and region the preview was computed for
+    uint64_t m_preview_key = 0;
+
+    /// @brief Number of matches reaching the preview region
+    size_t m_preview_matches = 0;
+
     /// @brief Copy of the search pattern
     grid m_search_pattern;
 
@@ -107,6 +460,31 @@ private:
 
     /// @brief Buffer for file name input
     char m_filename[256] = "";
+
+    /// @brief Load, save, import or export running off the UI thread
+    background_task m_file_task;
+
+    /// @brief Open native dialog, polled every frame, returns true once closed
+    std::function<bool()> m_pending_dialog;
+
+    /// @brief Error of the last file task, shown next to the file buttons
+    std::string m_file_status;
+
+    /// @brief Watches the current file for changes made by other programs
+    file_watcher m_watcher;
+
+    /// @brief Whether the watched file changed and still has to be reloaded
+    bool m_reload_pending = false;
+
+    /// @brief Hash of the file contents last loaded or saved, so the editor's
+    /// own saves don't trigger a reload
+    uint64_t m_file_hash = 0;
+
+    /// @brief Hash of the grid of the last reload, the input of its synthesis
+    uint64_t m_reload_input = 0;
+
+    /// @brief Outcome of the last reload
+    std::string m_watch_status;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "grid_canvas.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Largest zoom, in pixels per cell
+    const float max_zoom = 64.0f;
+
+    // Smallest size of a cell drawn as a rectangle, in pixels
+    const float min_rect_size = 4.0f;
+
+    // Smallest size of a cell that gets a label, in pixels
+    const float min_label_size = 12.0f;
+}
+
+grid_canvas::grid_canvas(SDL_Renderer* renderer)
+    : m_renderer(renderer)
+{
+}
+
+void grid_canvas::invalidate()
+{
+    m_rebuild = true;
+}
+
+void grid_canvas::set_overlay(match_overlay* overlay)
+{
+    m_overlay = overlay;
+    if (m_overlay)
+        m_overlay->invalidate();
+}
+
+void grid_canvas::invalidate_region(int x0, int y0, int x1, int y1)
+{
+    if (m_dirty_x0 > m_dirty_x1) {
+        m_dirty_x0 = x0;
+        m_dirty_y0 = y0;
+        m_dirty_x1 = x1;
+        m_dirty_y1 = y1;
+    } else {
+        m_dirty_x0 = std::min(m_dirty_x0, x0);
+        m_dirty_y0 = std::min(m_dirty_y0, y0);
+        m_dirty_x1 = std::max(m_dirty_x1, x1);
+        m_dirty_y1 = std::max(m_dirty_y1, y1);
+    }
+}
+
+ImVec2 grid_canvas::screen_to_grid(const ImVec2& screen) const
+{
+    return ImVec2(
+        m_pan.x + (screen.x - m_canvas_pos.x) / m_zoom,
+        m_pan.y + (screen.y - m_canvas_pos.y) / m_zoom
+    );
+}
+
+ImVec2 grid_canvas::grid_to_screen(const ImVec2& cell) const
+{
+    return ImVec2(
+        m_canvas_pos.x + (cell.x - m_pan.x) * m_zoom,
+        m_canvas_pos.y + (cell.y - m_pan.y) * m_zoom
+    );
+}
+
+bool grid_canvas::hovered_cell(int& x, int& y) const
+{
+    if (m_hover_x < 0)
+        return false;
+    x = m_hover_x;
+    y = m_hover_y;
+    return true;
+}
+
+void grid_canvas::sync(const grid& g)
+{
+    if (m_rebuild || g.width() != m_pyramid.width() || g.height() != m_pyramid.height()) {
+        if (m_overlay)
+            m_overlay->invalidate();
+        m_pyramid.build(g);
+        m_textures.resize(m_pyramid.level_count());
+        for (auto& texture : m_textures) {
+            if (texture)
+                texture->invalidate();
+        }
+        m_runs.assign(m_pyramid.level_count(), level_runs());
+        for (auto& runs : m_runs)
+            runs.dirty_last = INT_MAX;
+        m_rebuild = false;
+        m_dirty_x1 = -1;
+        m_dirty_x0 = 0;
+        return;
+    }
+
+    if (m_dirty_x0 > m_dirty_x1)
+        return;
+
+    if (m_overlay)
+        m_overlay->invalidate_region(m_dirty_x0, m_dirty_y0, m_dirty_x1, m_dirty_y1);
+    m_pyramid.update(g, m_dirty_x0, m_dirty_y0, m_dirty_x1, m_dirty_y1);
+    for (int level = 0; level < (int)m_textures.size(); ++level) {
+        if (m_textures[level])
+            m_textures[level]->invalidate_rows(m_dirty_y0 >> level, m_dirty_y1 >> level);
+        level_runs& runs = m_runs[level];
+        if (runs.dirty_first > runs.dirty_last) {
+            runs.dirty_first = m_dirty_y0 >> level;
+            runs.dirty_last = m_dirty_y1 >> level;
+        } else {
+            runs.dirty_first = std::min(runs.dirty_first, m_dirty_y0 >> level);
+            runs.dirty_last = std::max(runs.dirty_last, m_dirty_y1 >> level);
+        }
+    }
+    m_dirty_x1 = -1;
+    m_dirty_x0 = 0;
+}
+
+int grid_canvas::pick_level(bool textured) const
+{
+    // Textures can be minified a little, rectangles need to stay visible
+    float level = textured
+        ? std::floor(std::log2(1.0f / m_zoom))
+        : std::ceil(std::log2(min_rect_size / m_zoom));
+    return std::clamp((int)level, 0, m_pyramid.level_count() - 1);
+}
+
+grid_texture* grid_canvas::level_texture(int level, const grid& g)
+{
+    if (!m_renderer || level < 0 || level >= (int)m_textures.size())
+        return nullptr;
+    auto& texture = m_textures[level];
+    if (!texture)
+        texture = std::make_unique<grid_texture>(m_renderer);
+    return texture->update(level == 0 ? g : m_pyramid.level(level)) ? texture.get() : nullptr;
+}
+
+const std::vector<std::vector<grid_canvas::run>>& grid_canvas::runs(int level, const grid& source)
+{
+    level_runs& runs = m_runs[level];
+    if ((int)runs.rows.size() != source.height()) {
+        runs.rows.resize(source.height());
+        runs.dirty_first = 0;
+        runs.dirty_last = source.height() - 1;
+    }
+
+    const int last = std::min(runs.dirty_last, source.height() - 1);
+    for (int y = std::max(0, runs.dirty_first); y <= last; ++y) {
+        std::vector<run>& row = runs.rows[y];
+        row.clear();
+        for (int x = 0; x < source.width();) {
+            const int id = source(x, y);
+            int end = x + 1;
+            while (end < source.width() && source(end, y) == id)
+                end++;
+            row.push_back({x, end - x, id});
+            x = end;
+        }
+    }
+    runs.dirty_first = 0;
+    runs.dirty_last = -1;
+    return runs.rows;
+}
+
+void grid_canvas::view(ImVec2& min, ImVec2& max) const
+{
+    min = m_pan;
+    max = ImVec2(m_pan.x + m_canvas_size.x / m_zoom, m_pan.y + m_canvas_size.y / m_zoom);
+}
+
+void grid_canvas::center_on(const ImVec2& center)
+{
+    // Clamped to the grid on the next draw
+    m_pan.x = center.x - m_canvas_size.x / m_zoom * 0.5f;
+    m_pan.y = center.y - m_canvas_size.y / m_zoom * 0.5f;
+}
+
+void grid_canvas::handle_input(const grid& g)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    const bool hovered = ImGui::IsItemHovered();
+
+    // Zoom around the mouse cursor
+    if (hovered && io.MouseWheel != 0.0f) {
+        ImVec2 anchor = screen_to_grid(io.MousePos);
+        float fit_zoom = std::min(m_canvas_size.x / g.width(), m_canvas_size.y / g.height());
+        float min_zoom = std::min(1.0f, fit_zoom * 0.5f);
+        m_zoom = std::clamp(m_zoom * std::pow(1.2f, io.MouseWheel), min_zoom, max_zoom);
+        m_pan.x = anchor.x - (io.MousePos.x - m_canvas_pos.x) / m_zoom;
+        m_pan.y = anchor.y - (io.MousePos.y - m_canvas_pos.y) / m_zoom;
+    }
+
+    // Pan with the right or middle mouse button
+    if (ImGui::IsItemActive() &&
+        (ImGui::IsMouseDragging(ImGuiMouseButton_Right) || ImGui::IsMouseDragging(ImGuiMouseButton_Middle))) {
+        m_pan.x -= io.MouseDelta.x / m_zoom;
+        m_pan.y -= io.MouseDelta.y / m_zoom;
+    }
+
+    // Keep at least one cell of the grid in view
+    m_pan.x = std::clamp(m_pan.x, 1.0f - m_canvas_size.x / m_zoom, g.width() - 1.0f);
+    m_pan.y = std::clamp(m_pan.y, 1.0f - m_canvas_size.y / m_zoom, g.height() - 1.0f);
+
+    m_hover_x = m_hover_y = -1;
+    if (hovered) {
+        ImVec2 p = screen_to_grid(io.MousePos);
+        int x = (int)std::floor(p.x);
+        int y = (int)std::floor(p.y);
+        if (g.in_bounds(x, y)) {
+            m_hover_x = x;
+            m_hover_y = y;
+        }
+    }
+}
+
+void grid_canvas::draw(const char* id, const grid& g, const render_cache& cache, ImVec2 size)
+{
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    if (size.x <= 0.0f) size.x = avail.x;
+    if (size.y <= 0.0f) size.y = avail.y;
+    size.x = std::max(1.0f, size.x);
+    size.y = std::max(1.0f, size.y);
+    m_canvas_pos = ImGui::GetCursorScreenPos();
+    m_canvas_size = size;
+
+    ImGui::InvisibleButton(id, size, ImGuiButtonFlags_MouseButtonLeft |
+                                     ImGuiButtonFlags_MouseButtonRight |
+                                     ImGuiButtonFlags_MouseButtonMiddle);
+    if (g.width() < 1 || g.height() < 1)
+        return;
+
+    sync(g);
+
+    if (m_fit) {
+        m_zoom = std::min(max_zoom, std::min(size.x / g.width(), size.y / g.height()));
+        m_pan = ImVec2(0.0f, 0.0f);
+        m_fit = false;
+    }
+
+    handle_input(g);
+
+    // Visible range of cells, end exclusive
+    const int x0 = std::max(0, (int)std::floor(m_pan.x));
+    const int y0 = std::max(0, (int)std::floor(m_pan.y));
+    const int x1 = std::min(g.width(), (int)std::ceil(m_pan.x + size.x / m_zoom));
+    const int y1 = std::min(g.height(), (int)std::ceil(m_pan.y + size.y / m_zoom));
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    auto to_screen = [&](float x, float y) {
+        return ImVec2(m_canvas_pos.x + (x - m_pan.x) * m_zoom,
+                      m_canvas_pos.y + (y - m_pan.y) * m_zoom);
+    };
+
+    // Clip to the part of the canvas covered by the grid, coarse levels overhang the edge
+    ImVec2 grid_min = to_screen(0.0f, 0.0f);
+    ImVec2 grid_max = to_screen((float)g.width(), (float)g.height());
+    ImVec2 clip_min(std::max(grid_min.x, m_canvas_pos.x), std::max(grid_min.y, m_canvas_pos.y));
+    ImVec2 clip_max(std::min(grid_max.x, m_canvas_pos.x + size.x), std::min(grid_max.y, m_canvas_pos.y + size.y));
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(clip_min, clip_max, true);
+    draw_list->AddRectFilled(clip_min, clip_max, IM_COL32(50, 50, 50, 255));
+
+    // Textured levels, falling back to coarser ones if a texture is too large
+    bool textured = false;
+    for (int level = pick_level(true); m_renderer && level < m_pyramid.level_count(); ++level) {
+        const grid& source = level == 0 ? g : m_pyramid.level(level);
+        grid_texture* texture = level_texture(level, g);
+        if (!texture)
+            continue;
+
+        const int step = 1 << level;
+        const int tx0 = x0 >> level;
+        const int ty0 = y0 >> level;
+        const int tx1 = std::min(source.width(), (x1 + step - 1) >> level);
+        const int ty1 = std::min(source.height(), (y1 + step - 1) >> level);
+        draw_list->AddImage(
+            (ImTextureID)(intptr_t)texture->texture(),
+            to_screen((float)(tx0 * step), (float)(ty0 * step)),
+            to_screen((float)(tx1 * step), (float)(ty1 * step)),
+            ImVec2((float)tx0 / source.width(), (float)ty0 / source.height()),
+            ImVec2((float)tx1 / source.width(), (float)ty1 / source.height())
+        );
+        textured = true;
+        break;
+    }
+
+    // Rectangles from a level where cells are a few pixels large, one per
+    // run of equal cells, cut to the visible columns
+    if (!textured) {
+        const int level = pick_level(false);
+        const grid& source = level == 0 ? g : m_pyramid.level(level);
+        const auto& rows = runs(level, source);
+        const int step = 1 << level;
+        const int tx0 = x0 >> level;
+        const int tx1 = std::min(source.width(), (x1 + step - 1) >> level);
+        const int ty1 = std::min(source.height(), (y1 + step - 1) >> level);
+        for (int y = y0 >> level; y < ty1; ++y) {
+            const std::vector<run>& row = rows[y];
+            auto it = std::partition_point(row.begin(), row.end(),
+                                           [&](const run& r) { return r.x + r.length <= tx0; });
+            for (; it != row.end() && it->x < tx1; ++it) {
+                draw_list->AddRectFilled(
+                    to_screen((float)(std::max(it->x, tx0) * step), (float)(y * step)),
+                    to_screen((float)(std::min(it->x + it->length, tx1) * step), (float)((y + 1) * step)),
+                    cache.get(it->id).color
+                );
+            }
+        }
+    }
+
+    // Matches of the overlay pattern, a single quad over the whole grid
+    if (m_overlay && m_overlay->active() && m_overlay->update(g)) {
+        draw_list->AddImage((ImTextureID)(intptr_t)m_overlay->texture(), grid_min, grid_max);
+    }
+
+    // Labels for the visible cells once they are large enough to read
+    if (m_zoom >= min_label_size) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                const auto cell = cache.get(g(x, y));
+                if (!cell.label)
+                    continue;
+                ImVec2 cell_min = to_screen((float)x, (float)y);
+                ImVec2 text_pos(
+                    cell_min.x + (m_zoom - cell.label_size.x) * 0.5f,
+                    cell_min.y + (m_zoom - cell.label_size.y) * 0.5f
+                );
+                draw_list->AddText(text_pos, IM_COL32(255, 255, 255, 255), cell.label);
+            }
+        }
+    }
+
+    draw_list->PopClipRect();
+}
+
+size_t grid_canvas::bytes() const
+{
+    size_t total = m_pyramid.bytes();
+    for (const auto& runs : m_runs)
+        for (const auto& row : runs.rows)
+            total += row.capacity() * sizeof(run);
+    if (m_overlay)
+        total += m_overlay->bytes();
+    for (const auto& texture : m_textures)
+        if (texture)
+            total += texture->bytes();
+    return total;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "core/grid_synth.hpp"
+#include "core/grid_pyramid.hpp"
+#include "grid_texture.hpp"
+#include "match_overlay.hpp"
+#include "render_cache.hpp"
+#include "imgui.h"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            grid_canvas
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Zoomable, pannable view of a grid
+///
+/// Only the visible range of cells is drawn. When cells get smaller than a
+/// pixel the view switches to a coarser level of a grid_pyramid, so the cost
+/// of a frame depends on the size of the view and not of the grid. Each level
+/// is mirrored in a grid_texture when a renderer is available. Without one,
+/// cells are drawn as rectangles from a level where they are at least a few
+/// pixels large, merging horizontal runs of equal cells into one rectangle.
+///
+/// The mouse wheel zooms around the cursor, dragging with the right or middle
+/// button pans. The owner reports edits with invalidate() or
+/// invalidate_region() so the pyramid and textures can catch up.
+class grid_canvas
+{
+public:
+    /// @brief Constructor
+    /// @param renderer SDL renderer for the level textures, may be null
+    explicit grid_canvas(SDL_Renderer* renderer);
+
+    /// @brief Draw the grid into the remaining content region of the window
+    ///
+    /// Ends with an invisible button covering the canvas, so ImGui::IsItemHovered()
+    /// and friends refer to the canvas afterwards.
+    /// @param id ImGui ID of the canvas
+    /// @param g The grid
+    /// @param cache Colors and labels of the symbols
+    /// @param size Size of the canvas, the remaining content region by default
+    void draw(const char* id, const grid& g, const render_cache& cache, ImVec2 size = ImVec2(0.0f, 0.0f));
+
+    /// @brief Mark the whole grid as changed, including its size
+    void invalidate();
+
+    /// @brief Mark a region of the grid as changed
+    /// @param x0 Left column
+    /// @param y0 Top row
+    /// @param x1 Right column, inclusive
+    /// @param y1 Bottom row, inclusive
+    void invalidate_region(int x0, int y0, int x1, int y1);
+
+    /// @brief Fit the whole grid into the view on the next draw
+    void fit() { m_fit = true; }
+
+    /// @brief Draw a match overlay on top of the grid
+    ///
+    /// Changes reported to the canvas are passed on to the overlay, which is
+    /// updated and drawn when it is active.
+    /// @param overlay The overlay, or null for none
+    void set_overlay(match_overlay* overlay);
+
+    /// @brief Get the cell under the mouse cursor
+    /// @param x Receives the column
+    /// @param y Receives the row
+    /// @return True if the mouse is over a cell of the grid
+    bool hovered_cell(int& x, int& y) const;
+
+    /// @brief Convert a screen position to grid coordinates
+    /// @param screen The screen position
+    /// @return Position in cells, fractional
+    ImVec2 screen_to_grid(const ImVec2& screen) const;
+
+    /// @brief Convert grid coordinates to a screen position
+    /// @param cell Position in cells, fractional
+    /// @return The screen position
+    ImVec2 grid_to_screen(const ImVec2& cell) const;
+
+    /// @brief Get the zoom factor
+    /// @return Pixels per cell
+    float zoom() const { return m_zoom; }
+
+    /// @brief Get the pyramid of the grid
+    /// @return The pyramid, up to date after the last draw
+    const grid_pyramid& pyramid() const { return m_pyramid; }
+
+    /// @brief Get the texture of a pyramid level, uploading its changed rows
+    ///
+    /// Textures are shared with the canvas, so other views of the grid such
+    /// as a minimap cost no extra uploads for the levels the canvas uses.
+    /// @param level The level, from 0 to pyramid().level_count() - 1
+    /// @param g The grid, as passed to the last draw
+    /// @return The texture, or null without a renderer or if it is too large
+    grid_texture* level_texture(int level, const grid& g);
+
+    /// @brief Get the region of the grid in view
+    /// @param min Receives the top-left corner, in cells
+    /// @param max Receives the bottom-right corner, in cells
+    void view(ImVec2& min, ImVec2& max) const;
+
+    /// @brief Move the view so it is centered on a position
+    /// @param center The position, in cells
+    void center_on(const ImVec2& center);
+
+    /// @brief Get the memory used by the pyramid and the textures
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    /// @brief Horizontal run of equal cells
+    struct run {
+        int x;
+        int length;
+        int id;
+    };
+
+    /// @brief Runs of every row of a pyramid level, rebuilt for changed rows only
+    struct level_runs {
+        std::vector<std::vector<run>> rows;
+        int dirty_first = 0;            ///< First row to rebuild
+        int dirty_last = -1;            ///< Last row to rebuild, inclusive
+    };
+
+    void sync(const grid& g);
+    const std::vector<std::vector<run>>& runs(int level, const grid& source);
+    void handle_input(const grid& g);
+    int pick_level(bool textured) const;
+
+    SDL_Renderer* m_renderer;
+    grid_pyramid m_pyramid;
+    std::vector<std::unique_ptr<grid_texture>> m_textures;     ///< One texture per pyramid level
+    std::vector<level_runs> m_runs;                             ///< One run list per pyramid level
+    match_overlay* m_overlay = nullptr;
+
+    bool m_rebuild = true;              ///< Whether the whole grid changed
+    int m_dirty_x0 = 0;                 ///< Changed region, empty when x0 > x1
+    int m_dirty_y0 = 0;
+    int m_dirty_x1 = -1;
+    int m_dirty_y1 = -1;
+
+    bool m_fit = true;                  ///< Whether to fit the grid on the next draw
+    float m_zoom = 1.0f;                ///< Pixels per cell
+    ImVec2 m_pan;                       ///< Grid position at the top-left of the canvas, in cells
+    ImVec2 m_canvas_pos;                ///< Screen position of the canvas
+    ImVec2 m_canvas_size;               ///< Size of the canvas
+    int m_hover_x = -1;
+    int m_hover_y = -1;
+};
+
+}
@@ -0,0 +1,134 @@
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstring>
+#include "grid_texture.hpp"
+#include "core/palette.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Symbol IDs with a precomputed color, from the wildcard up
+    const int color_table_size = 1024;
+}
+
+grid_texture::grid_texture(SDL_Renderer* renderer)
+    : m_renderer(renderer)
+{
+}
+
+grid_texture::~grid_texture()
+{
+    if (m_texture)
+        SDL_DestroyTexture(m_texture);
+}
+
+void grid_texture::set_colors(std::vector<uint32_t> colors)
+{
+    m_colors = std::move(colors);
+    m_fixed_colors = true;
+    invalidate();
+}
+
+void grid_texture::invalidate()
+{
+    m_dirty_first = 0;
+    m_dirty_last = m_height - 1;
+}
+
+void grid_texture::invalidate_rows(int first, int last)
+{
+    first = std::max(first, 0);
+    last = std::min(last, m_height - 1);
+    if (first > last)
+        return;
+    if (m_dirty_first > m_dirty_last) {
+        m_dirty_first = first;
+        m_dirty_last = last;
+    } else {
+        m_dirty_first = std::min(m_dirty_first, first);
+        m_dirty_last = std::max(m_dirty_last, last);
+    }
+}
+
+uint32_t grid_texture::cell_color(int id)
+{
+    if (m_fixed_colors)
+        return id >= 0 && id < (int)m_colors.size() ? m_colors[id] : 0;
+
+    // Texels are RGBA in memory order, which is the layout of gs::color
+    auto pack = [](int id) {
+        color c = nice_color(id);
+        uint32_t packed;
+        std::memcpy(&packed, &c, sizeof(packed));
+        return packed;
+    };
+
+    const int index = id - alphabet::wildcard_symbol.id;
+    if (index < 0 || index >= color_table_size)
+        return pack(id);
+
+    if (m_colors.empty()) {
+        m_colors.resize(color_table_size);
+        for (int i = 0; i < color_table_size; ++i)
+            m_colors[i] = pack(i + alphabet::wildcard_symbol.id);
+    }
+    return m_colors[index];
+}
+
+bool grid_texture::update(const grid& g)
+{
+    if (!m_renderer || g.width() < 1 || g.height() < 1)
+        return false;
+
+    // Recreate the texture when the grid size changes
+    if (!m_texture || g.width() != m_width || g.height() != m_height) {
+        if (m_texture)
+            SDL_DestroyTexture(m_texture);
+        m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA32,
+                                      SDL_TEXTUREACCESS_STREAMING, g.width(), g.height());
+        if (!m_texture) {
+            m_width = m_height = 0;
+            return false;
+        }
+        SDL_SetTextureScaleMode(m_texture, SDL_SCALEMODE_NEAREST);
+        m_width = g.width();
+        m_height = g.height();
+        invalidate();
+    }
+
+    if (m_dirty_first > m_dirty_last)
+        return true;
+
+    // Upload the dirty rows as one rectangle
+    const int rows = m_dirty_last - m_dirty_first + 1;
+    m_pixels.resize((size_t)m_width * rows);
+    const int* cells = g.raw_data() + (size_t)m_dirty_first * m_width;
+    uint32_t* px = m_pixels.data();
+
+    // Neighbouring cells usually hold the same symbol
+    int last_id = cells[0];
+    uint32_t last_color = cell_color(last_id);
+    for (size_t i = 0, n = m_pixels.size(); i < n; ++i) {
+        if (cells[i] != last_id) {
+            last_id = cells[i];
+            last_color = cell_color(last_id);
+        }
+        px[i] = last_color;
+    }
+
+    SDL_Rect rect = { 0, m_dirty_first, m_width, rows };
+    SDL_UpdateTexture(m_texture, &rect, m_pixels.data(), m_width * (int)sizeof(uint32_t));
+
+    m_dirty_first = 0;
+    m_dirty_last = -1;
+    return true;
+}
+
+size_t grid_texture::bytes() const
+{
+    size_t total = (m_pixels.capacity() + m_colors.capacity()) * sizeof(uint32_t);
+    if (m_texture)
+        total += (size_t)m_width * m_height * sizeof(uint32_t);
+    return total;
+}
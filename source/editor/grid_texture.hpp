@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "core/grid_synth.hpp"
+
+struct SDL_Renderer;
+struct SDL_Texture;
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            grid_texture
+////////////////////////////////////////////////////////////////////////////////
+/// @brief GPU texture mirroring a grid with one texel per cell
+///
+/// Cells are colored with nice_color(), so the whole grid can be drawn with a
+/// single textured quad scaled with nearest filtering. Only rows marked dirty
+/// are uploaded again, the texture is recreated when the grid size changes.
+class grid_texture
+{
+public:
+    /// @brief Constructor
+    /// @param renderer The SDL renderer to create the texture with, may be null
+    explicit grid_texture(SDL_Renderer* renderer);
+
+    /// @brief Destructor, releases the texture
+    ~grid_texture();
+
+    grid_texture(const grid_texture&) = delete;
+    grid_texture& operator=(const grid_texture&) = delete;
+
+    /// @brief Bring the texture up to date with a grid
+    /// @param g The grid
+    /// @return True if the texture can be drawn
+    bool update(const grid& g);
+
+    /// @brief Color cells with a fixed table instead of the symbol colors
+    ///
+    /// Values outside the table become transparent, which makes the texture
+    /// usable as an overlay on top of a grid.
+    /// @param colors Packed RGBA colors of the values 0 to colors.size() - 1
+    void set_colors(std::vector<uint32_t> colors);
+
+    /// @brief Mark every row as dirty
+    void invalidate();
+
+    /// @brief Mark a range of rows as dirty
+    /// @param first First row
+    /// @param last Last row, inclusive
+    void invalidate_rows(int first, int last);
+
+    /// @brief Get the texture
+    /// @return The texture, or null if there is no renderer
+    SDL_Texture* texture() const { return m_texture; }
+
+    /// @brief Get the memory used by the texture and its staging buffer
+    /// @return Size in bytes, the texture counted as 4 bytes per pixel
+    size_t bytes() const;
+
+private:
+    uint32_t cell_color(int id);
+
+    SDL_Renderer* m_renderer;
+    SDL_Texture* m_texture = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+
+    int m_dirty_first = 0;              ///< First dirty row
+    int m_dirty_last = -1;              ///< Last dirty row, inclusive
+
+    std::vector<uint32_t> m_pixels;     ///< Staging buffer for uploads
+    std::vector<uint32_t> m_colors;     ///< Packed colors of small symbol IDs
+    bool m_fixed_colors = false;        ///< Whether m_colors was set with set_colors()
+};
+
+}
@@ -0,0 +1,71 @@
+#include "history.hpp"
+
+using namespace gs;
+
+////////////////////////////////////////////////////////////////////////////////
+////                            history
+////////////////////////////////////////////////////////////////////////////////
+
+history::history(size_t max_bytes)
+    : m_max_bytes(max_bytes)
+{
+}
+
+size_t history::entry_bytes(const entry& e)
+{
+    return sizeof(entry) + e.label.capacity() + e.grid_change.bytes() +
+           e.pipeline_before.capacity() + e.pipeline_after.capacity();
+}
+
+void history::push(entry e)
+{
+    // A new step replaces everything that could be redone
+    while (m_entries.size() > m_position) {
+        m_bytes -= entry_bytes(m_entries.back());
+        m_entries.pop_back();
+    }
+
+    m_bytes += entry_bytes(e);
+    m_entries.push_back(std::move(e));
+    m_position = m_entries.size();
+
+    // Forget the oldest steps once over budget
+    while (m_bytes > m_max_bytes && !m_entries.empty()) {
+        m_bytes -= entry_bytes(m_entries.front());
+        m_entries.pop_front();
+        m_position--;
+    }
+}
+
+const history::entry* history::undo()
+{
+    if (!can_undo())
+        return nullptr;
+    return &m_entries[--m_position];
+}
+
+const history::entry* history::redo()
+{
+    if (!can_redo())
+        return nullptr;
+    return &m_entries[m_position++];
+}
+
+const std::string& history::undo_label() const
+{
+    static const std::string none;
+    return can_undo() ? m_entries[m_position - 1].label : none;
+}
+
+const std::string& history::redo_label() const
+{
+    static const std::string none;
+    return can_redo() ? m_entries[m_position].label : none;
+}
+
+void history::clear()
+{
+    m_entries.clear();
+    m_position = 0;
+    m_bytes = 0;
+}
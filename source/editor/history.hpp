@@ -0,0 +1,82 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include "core/grid_diff.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            history
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Undo and redo stack of the editor
+///
+/// Each entry holds a grid change, a pipeline change (the pipeline JSON
+/// before and after), or both. The memory used by the entries is capped; when
+/// it is exceeded the oldest entries are dropped.
+class history
+{
+public:
+    /// @brief An undoable step
+    struct entry {
+        std::string label;              ///< Description shown in the UI
+        grid_diff grid_change;          ///< Change to the grid, may be empty
+        std::string pipeline_before;    ///< Pipeline JSON before, empty if unchanged
+        std::string pipeline_after;     ///< Pipeline JSON after, empty if unchanged
+    };
+
+    /// @brief Constructor
+    /// @param max_bytes Maximum memory used by the entries
+    explicit history(size_t max_bytes = 64ull * 1024 * 1024);
+
+    /// @brief Add a step, discarding everything that could be redone
+    /// @param e The step
+    void push(entry e);
+
+    /// @brief Step back
+    /// @return The step to revert, or null if there is none
+    const entry* undo();
+
+    /// @brief Step forward again
+    /// @return The step to reapply, or null if there is none
+    const entry* redo();
+
+    /// @brief Check if there is a step to undo
+    bool can_undo() const { return m_position > 0; }
+
+    /// @brief Check if there is a step to redo
+    bool can_redo() const { return m_position < m_entries.size(); }
+
+    /// @brief Get the label of the next step to undo
+    /// @return The label, or an empty string
+    const std::string& undo_label() const;
+
+    /// @brief Get the label of the next step to redo
+    /// @return The label, or an empty string
+    const std::string& redo_label() const;
+
+    /// @brief Remove all steps
+    void clear();
+
+    /// @brief Get the number of steps
+    size_t size() const { return m_entries.size(); }
+
+    /// @brief Get the memory used by the steps
+    /// @return Size in bytes
+    size_t bytes() const { return m_bytes; }
+
+    /// @brief Get the memory limit
+    /// @return Size in bytes
+    size_t max_bytes() const { return m_max_bytes; }
+
+private:
+    static size_t entry_bytes(const entry& e);
+
+    std::deque<entry> m_entries;
+    size_t m_position = 0;              ///< Number of steps that are done
+    size_t m_bytes = 0;
+    size_t m_max_bytes;
+};
+
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "match_overlay.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Color of matching positions, RGBA in memory order
+    const uint32_t match_color = 0x9000ffffu;
+}
+
+match_overlay::match_overlay(SDL_Renderer* renderer)
+    : m_texture(renderer)
+{
+    m_texture.set_colors({0u, match_color});
+}
+
+void match_overlay::set_pattern(const grid* pattern)
+{
+    if (!pattern) {
+        m_matcher.reset();
+        return;
+    }
+
+    const bool same = m_matcher &&
+                      pattern->width() == m_pattern.width() &&
+                      pattern->height() == m_pattern.height() &&
+                      std::equal(pattern->raw_data(),
+                                 pattern->raw_data() + (size_t)pattern->width() * pattern->height(),
+                                 m_pattern.raw_data());
+    if (same)
+        return;
+
+    m_pattern = *pattern;
+    m_matcher = std::make_unique<pattern_matcher>(m_pattern);
+    m_rebuild = true;
+}
+
+void match_overlay::invalidate()
+{
+    m_rebuild = true;
+}
+
+void match_overlay::invalidate_region(int x0, int y0, int x1, int y1)
+{
+    if (m_dirty_x0 > m_dirty_x1) {
+        m_dirty_x0 = x0;
+        m_dirty_y0 = y0;
+        m_dirty_x1 = x1;
+        m_dirty_y1 = y1;
+    } else {
+        m_dirty_x0 = std::min(m_dirty_x0, x0);
+        m_dirty_y0 = std::min(m_dirty_y0, y0);
+        m_dirty_x1 = std::max(m_dirty_x1, x1);
+        m_dirty_y1 = std::max(m_dirty_y1, y1);
+    }
+}
+
+bool match_overlay::update(const grid& g)
+{
+    if (!m_matcher || g.width() < 1 || g.height() < 1)
+        return false;
+
+    if (m_rebuild || g.width() != m_mask.width() || g.height() != m_mask.height()) {
+        if (g.width() != m_mask.width() || g.height() != m_mask.height())
+            m_mask.resize(g.width(), g.height());
+        m_count = m_matcher->find(g, m_mask, 0, 0, g.width() - 1, g.height() - 1);
+        m_texture.invalidate();
+        m_rebuild = false;
+    }
+    else if (m_dirty_x0 <= m_dirty_x1) {
+        // Positions whose pattern window overlaps the changed cells
+        const int x0 = std::max(0, m_dirty_x0 - m_matcher->width() + 1);
+        const int y0 = std::max(0, m_dirty_y0 - m_matcher->height() + 1);
+        const int x1 = std::min(g.width() - 1, m_dirty_x1);
+        const int y1 = std::min(g.height() - 1, m_dirty_y1);
+
+        size_t before = 0;
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                before += m_mask(x, y);
+        m_count = m_count - before + m_matcher->find(g, m_mask, x0, y0, x1, y1);
+        m_texture.invalidate_rows(y0, y1);
+    }
+    m_dirty_x0 = 0;
+    m_dirty_x1 = -1;
+
+    return m_texture.update(m_mask);
+}
+
+size_t match_overlay::bytes() const
+{
+    return (size_t)m_mask.width() * m_mask.height() * sizeof(int) + m_texture.bytes();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include "core/grid_synth.hpp"
+#include "core/pattern_matcher.hpp"
+#include "grid_texture.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            match_overlay
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Texture layer marking where a search pattern matches a grid
+///
+/// Holds a mask with one cell per grid cell, set where the top-left cell of
+/// the pattern can be placed. Edits to the grid only rescan the positions
+/// whose pattern window overlaps the edited region, and only the rows of
+/// the mask that changed are uploaded again. Attach it to a grid_canvas with
+/// grid_canvas::set_overlay() to get the edits reported and the layer drawn.
+class match_overlay
+{
+public:
+    /// @brief Constructor
+    /// @param renderer SDL renderer for the mask texture, may be null
+    explicit match_overlay(SDL_Renderer* renderer);
+
+    /// @brief Set the pattern to show, rescanning the grid if it changed
+    /// @param pattern The search pattern, or null to hide the overlay
+    void set_pattern(const grid* pattern);
+
+    /// @brief Check if a pattern is set
+    bool active() const { return m_matcher != nullptr; }
+
+    /// @brief Mark the whole grid as changed
+    void invalidate();
+
+    /// @brief Mark a region of the grid as changed
+    /// @param x0 Left column
+    /// @param y0 Top row
+    /// @param x1 Right column, inclusive
+    /// @param y1 Bottom row, inclusive
+    void invalidate_region(int x0, int y0, int x1, int y1);
+
+    /// @brief Rescan the changed positions and upload the changed rows
+    /// @param g The grid
+    /// @return True if the texture can be drawn
+    bool update(const grid& g);
+
+    /// @brief Get the number of matching positions as of the last update
+    size_t count() const { return m_count; }
+
+    /// @brief Get the mask texture, one texel per grid cell
+    SDL_Texture* texture() const { return m_texture.texture(); }
+
+    /// @brief Get the memory used by the mask and its texture
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    grid m_pattern{0, 0};
+    std::unique_ptr<pattern_matcher> m_matcher;
+    grid m_mask{0, 0};
+    size_t m_count = 0;
+    grid_texture m_texture;
+
+    bool m_rebuild = true;              ///< Whether the whole mask is out of date
+    int m_dirty_x0 = 0;                 ///< Changed region of the grid, empty when x0 > x1
+    int m_dirty_y0 = 0;
+    int m_dirty_x1 = -1;
+    int m_dirty_y1 = -1;
+};
+
+}
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include "minimap.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Smallest size of a cell drawn as a rectangle, in pixels
+    const float min_rect_size = 2.0f;
+}
+
+bool gs::draw_minimap(const char* id, grid_canvas& canvas, const grid& g, const render_cache& cache, float max_size)
+{
+    const grid_pyramid& pyramid = canvas.pyramid();
+    if (g.width() < 1 || g.height() < 1 || pyramid.width() != g.width() || pyramid.height() != g.height())
+        return false;
+
+    const float scale = max_size / std::max(g.width(), g.height());
+    const ImVec2 size(g.width() * scale, g.height() * scale);
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton(id, size);
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(pos, ImVec2(pos.x + size.x, pos.y + size.y), true);
+
+    // Coarsest level still having a cell per pixel, the texture does the rest
+    const int last = pyramid.level_count() - 1;
+    int level = std::clamp((int)std::floor(std::log2(1.0f / scale)), 0, last);
+    bool textured = false;
+    for (; level <= last; ++level) {
+        if (grid_texture* texture = canvas.level_texture(level, g)) {
+            const grid& source = level == 0 ? g : pyramid.level(level);
+            const float step = (float)(1 << level) * scale;
+            draw_list->AddImage((ImTextureID)(intptr_t)texture->texture(), pos,
+                                ImVec2(pos.x + source.width() * step, pos.y + source.height() * step));
+            textured = true;
+            break;
+        }
+    }
+
+    // Without textures, rectangles from a level where they stay visible
+    if (!textured) {
+        level = std::clamp((int)std::ceil(std::log2(min_rect_size / scale)), 0, last);
+        const grid& source = level == 0 ? g : pyramid.level(level);
+        const float step = (float)(1 << level) * scale;
+        for (int y = 0; y < source.height(); ++y) {
+            for (int x = 0; x < source.width(); ++x) {
+                draw_list->AddRectFilled(ImVec2(pos.x + x * step, pos.y + y * step),
+                                         ImVec2(pos.x + (x + 1) * step, pos.y + (y + 1) * step),
+                                         cache.get(source(x, y)).color);
+            }
+        }
+    }
+
+    // Outline of the part in view of the canvas
+    ImVec2 view_min, view_max;
+    canvas.view(view_min, view_max);
+    draw_list->AddRect(ImVec2(pos.x + view_min.x * scale, pos.y + view_min.y * scale),
+                       ImVec2(pos.x + view_max.x * scale, pos.y + view_max.y * scale),
+                       IM_COL32(255, 255, 255, 255));
+    draw_list->PopClipRect();
+
+    if (ImGui::IsItemActive() && ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        const ImVec2 mouse = ImGui::GetIO().MousePos;
+        canvas.center_on(ImVec2((mouse.x - pos.x) / scale, (mouse.y - pos.y) / scale));
+        return true;
+    }
+    return false;
+}
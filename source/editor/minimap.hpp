@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core/grid_synth.hpp"
+#include "grid_canvas.hpp"
+#include "render_cache.hpp"
+
+namespace gs
+{
+
+/// @brief Draw an overview of the grid shown by a canvas
+///
+/// The overview is drawn from the pyramid level of the canvas whose cells are
+/// closest to one pixel, using the texture the canvas keeps for that level,
+/// so it costs the same on a 4096x4096 grid as on a small one and only the
+/// rows changed since the last frame are uploaded. The part of the grid in
+/// view of the canvas is outlined; clicking or dragging moves it.
+/// @param id ImGui ID of the minimap
+/// @param canvas The canvas, drawn earlier in the frame
+/// @param g The grid shown by the canvas
+/// @param cache Colors of the symbols, used without a renderer
+/// @param max_size Largest side of the minimap in pixels
+/// @return True if the view of the canvas was moved
+bool draw_minimap(const char* id, grid_canvas& canvas, const grid& g, const render_cache& cache, float max_size);
+
+}
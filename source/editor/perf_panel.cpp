@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstring>
+#include "perf_panel.hpp"
+#include "imgui.h"
+
+using namespace gs;
+
+namespace
+{
+    // Number of frames the percentiles are computed over
+    const size_t frame_history = 240;
+
+    double to_ms(float seconds) { return seconds * 1000.0; }
+
+    double to_mb(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+}
+
+void perf_panel::timings::add(float seconds)
+{
+    samples[next] = seconds;
+    next = (next + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+}
+
+float perf_panel::timings::percentile(float p) const
+{
+    if (count == 0)
+        return 0.0f;
+    std::vector<float> sorted(samples.begin(), samples.begin() + count);
+    size_t n = std::min(count - 1, (size_t)(p * (count - 1) + 0.5f));
+    std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+    return sorted[n];
+}
+
+perf_panel::perf_panel()
+{
+    m_frame.samples.resize(frame_history);
+    m_editor.samples.resize(frame_history);
+    m_synthesizer.samples.resize(frame_history);
+}
+
+void perf_panel::add_frame(float frame_seconds, float editor_seconds, float synthesizer_seconds)
+{
+    m_frame.add(frame_seconds);
+    m_editor.add(editor_seconds);
+    m_synthesizer.add(synthesizer_seconds);
+}
+
+void perf_panel::set_profile(std::vector<stage_profile>&& profile, bool cache_hit)
+{
+    m_profile = std::move(profile);
+    m_profile_cache_hit = cache_hit;
+    m_has_profile = true;
+}
+
+void perf_panel::track_memory(const char* name, size_t bytes)
+{
+    for (auto& e : m_memory) {
+        if (e.name == name || strcmp(e.name, name) == 0) {
+            e.current = bytes;
+            e.peak = std::max(e.peak, bytes);
+            return;
+        }
+    }
+    m_memory.push_back({name, bytes, bytes});
+}
+
+void perf_panel::draw(bool* open)
+{
+    ImGui::SetNextWindowSize(ImVec2(420, 480), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Performance", open)) {
+        ImGui::End();
+        return;
+    }
+
+    // Frame timings
+    ImGui::Text("Frames");
+    ImGui::Separator();
+    if (ImGui::BeginTable("##FrameTable", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+
+        const std::pair<const char*, const timings*> rows[] = {
+            {"Frame", &m_frame},
+            {"Editor", &m_editor},
+            {"Synthesizer", &m_synthesizer},
+        };
+        for (const auto& [label, t] : rows) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", label);
+            for (float p : {0.5f, 0.95f, 0.99f, 1.0f}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", to_ms(t->percentile(p)));
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::TextDisabled("Over the last %zu frames, frame times include idle waits", m_frame.count);
+
+    const ImGuiIO& io = ImGui::GetIO();
+    ImGui::Text("%d vertices, %d indices, %d windows",
+                io.MetricsRenderVertices, io.MetricsRenderIndices, io.MetricsRenderWindows);
+
+    // Last synthesis, one row per enabled stage
+    ImGui::Spacing();
+    ImGui::Text("Last synthesis");
+    ImGui::Separator();
+    if (!m_has_profile) {
+        ImGui::TextDisabled("No synthesis yet");
+    }
+    else if (m_profile_cache_hit) {
+        ImGui::TextDisabled("Loaded from the result cache");
+    }
+    else if (ImGui::BeginTable("##ProfileTable", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("Matches");
+        ImGui::TableSetupColumn("Cells written");
+        ImGui::TableHeadersRow();
+
+        double total = 0.0;
+        for (const auto& stage : m_profile) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu. %s", stage.index + 1, stage.name.c_str());
+            ImGui::TableNextColumn();
+            if (stage.cached) {
+                ImGui::TextDisabled("cached");
+                continue;
+            }
+            ImGui::Text("%.2f", stage.seconds * 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stage.matches);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stage.cells_written);
+            total += stage.seconds;
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("Total");
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", total * 1000.0);
+        ImGui::EndTable();
+    }
+
+    // Memory
+    ImGui::Spacing();
+    ImGui::Text("Memory");
+    ImGui::Separator();
+    if (ImGui::BeginTable("##MemoryTable", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableSetupColumn("Current");
+        ImGui::TableSetupColumn("Peak");
+        ImGui::TableHeadersRow();
+
+        size_t current = 0, peak = 0;
+        for (const auto& e : m_memory) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", e.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", to_mb(e.current));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", to_mb(e.peak));
+            current += e.current;
+            peak += e.peak;
+        }
+
+        // Peaks of different entries need not coincide, their sum is an upper bound
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("Total");
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", to_mb(current));
+        ImGui::TableNextColumn();
+        ImGui::Text("<= %.2f", to_mb(peak));
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "core/grid_synth.hpp"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            perf_panel
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Performance overlay of the editor
+///
+/// Collects frame timings, the profile of the last synthesis and the memory
+/// used by grids and caches, and shows them in a window. Timings of the last
+/// few seconds of frames are kept to report percentiles; for memory both the
+/// current size and the peak since startup are kept.
+class perf_panel
+{
+public:
+    /// @brief Constructor
+    perf_panel();
+
+    /// @brief Record the timings of a frame
+    /// @param frame_seconds Time since the previous frame, includes idle waits
+    /// @param editor_seconds Time spent building the editor UI
+    /// @param synthesizer_seconds Part of that spent in the Synthesizer window
+    void add_frame(float frame_seconds, float editor_seconds, float synthesizer_seconds);
+
+    /// @brief Replace the profile of the last synthesis
+    /// @param profile The per-stage profile, taken over by the panel
+    /// @param cache_hit Whether the result came from the result cache
+    void set_profile(std::vector<stage_profile>&& profile, bool cache_hit);
+
+    /// @brief Report the memory used by a grid or cache
+    /// @param name Label shown in the panel, must be a string literal
+    /// @param bytes The current size in bytes
+    void track_memory(const char* name, size_t bytes);
+
+    /// @brief Draw the panel window
+    /// @param open Cleared when the window is closed
+    void draw(bool* open);
+
+private:
+    /// @brief A ring buffer of frame timings
+    struct timings {
+        std::vector<float> samples;
+        size_t next = 0;
+        size_t count = 0;
+
+        void add(float seconds);
+        float percentile(float p) const;
+    };
+
+    struct memory_entry {
+        const char* name;
+        size_t current;
+        size_t peak;
+    };
+
+    timings m_frame;
+    timings m_editor;
+    timings m_synthesizer;
+
+    std::vector<stage_profile> m_profile;
+    bool m_profile_cache_hit = false;
+    bool m_has_profile = false;
+
+    std::vector<memory_entry> m_memory;
+};
+
+}
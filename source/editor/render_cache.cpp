@@ -0,0 +1,85 @@
+#include <algorithm>
+#include "render_cache.hpp"
+#include "core/palette.hpp"
+
+using namespace gs;
+
+namespace
+{
+    // Largest ID range stored densely, symbols further apart go to the map
+    const int64_t max_dense_range = 65536;
+}
+
+render_cache::entry render_cache::make_entry(int id, const char* label) const
+{
+    color c = nice_color(id);
+    entry e;
+    e.color = IM_COL32(c.r, c.g, c.b, c.a);
+    e.label = label;
+    e.label_size = label ? ImGui::CalcTextSize(label) : ImVec2(0.0f, 0.0f);
+    return e;
+}
+
+render_cache::entry render_cache::get_sparse(int id) const
+{
+    auto it = m_sparse.find(id);
+    if (it != m_sparse.end())
+        return it->second;
+
+    // Unknown symbol far outside the alphabet, only the color depends on the ID
+    color c = nice_color(id);
+    return { IM_COL32(c.r, c.g, c.b, c.a), "?", m_unknown_size };
+}
+
+void render_cache::update(const alphabet& a)
+{
+    const float font_size = ImGui::GetFontSize();
+    if (a.version() == m_version && font_size == m_font_size)
+        return;
+    m_version = a.version();
+    m_font_size = font_size;
+
+    const auto& symbols = a.get_symbols();
+    m_dense.clear();
+    m_sparse.clear();
+    m_labels.clear();
+    m_unknown_size = ImGui::CalcTextSize("?");
+
+    // Labels are stored first so the pointers stay valid
+    m_labels.reserve(symbols.size());
+    for (const auto& s : symbols)
+        m_labels.push_back(s.name);
+
+    // Dense range covering the special symbols and the alphabet
+    int64_t first = alphabet::wildcard_symbol.id;
+    int64_t last = alphabet::empty_symbol.id;
+    if (!symbols.empty()) {
+        first = std::min<int64_t>(first, symbols.front().id);
+        last = std::max<int64_t>(last, symbols.back().id);
+    }
+    if (last - first >= max_dense_range) {
+        // Widely spread IDs, keep the range next to the special symbols
+        first = alphabet::wildcard_symbol.id;
+        last = first + max_dense_range - 1;
+    }
+    m_first = first;
+
+    m_dense.resize((size_t)(last - first + 1));
+    for (int64_t id = first; id <= last; ++id) {
+        color c = nice_color((int)id);
+        m_dense[(size_t)(id - first)] = { IM_COL32(c.r, c.g, c.b, c.a), "?", m_unknown_size };
+    }
+    m_dense[(size_t)(alphabet::wildcard_symbol.id - first)] = make_entry(alphabet::wildcard_symbol.id, "*");
+    m_dense[(size_t)(alphabet::empty_symbol.id - first)] = make_entry(alphabet::empty_symbol.id, nullptr);
+
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        const int id = symbols[i].id;
+        if (id == alphabet::wildcard_symbol.id || id == alphabet::empty_symbol.id)
+            continue;
+        entry e = make_entry(id, m_labels[i].c_str());
+        if (id >= first && id - first < (int64_t)m_dense.size())
+            m_dense[(size_t)(id - first)] = e;
+        else
+            m_sparse.emplace(id, e);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "core/grid_synth.hpp"
+#include "imgui.h"
+
+namespace gs
+{
+
+////////////////////////////////////////////////////////////////////////////////
+////                            render_cache
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Per-symbol drawing data for grid canvases
+///
+/// Holds the packed color, label and label size of every symbol so drawing a
+/// cell is a table lookup instead of a color conversion, a string copy, a map
+/// lookup and a text measurement. Rebuilt when the alphabet version or the
+/// font size changes.
+class render_cache
+{
+public:
+    /// @brief Drawing data of one symbol
+    struct entry {
+        ImU32 color;            ///< Packed cell color
+        const char* label;      ///< Label text, or null when there is nothing to draw
+        ImVec2 label_size;      ///< Size of the label in the current font
+    };
+
+    /// @brief Rebuild the cache if the alphabet or font changed
+    /// @param a The alphabet
+    void update(const alphabet& a);
+
+    /// @brief Get the drawing data of a symbol
+    /// @param id The symbol ID
+    /// @return The entry, unknown symbols are labeled "?"
+    entry get(int id) const
+    {
+        size_t i = (size_t)((int64_t)id - m_first);
+        if (i < m_dense.size())
+            return m_dense[i];
+        return get_sparse(id);
+    }
+
+private:
+    entry get_sparse(int id) const;
+    entry make_entry(int id, const char* label) const;
+
+    uint64_t m_version = 0;
+    float m_font_size = 0.0f;
+
+    int64_t m_first = 0;                            ///< Symbol ID of m_dense[0]
+    std::vector<entry> m_dense;                     ///< Entries for a contiguous ID range
+    std::unordered_map<int, entry> m_sparse;        ///< Entries outside that range
+    std::vector<std::string> m_labels;              ///< Storage for the label pointers
+    ImVec2 m_unknown_size;                          ///< Size of the "?" label
+};
+
+}
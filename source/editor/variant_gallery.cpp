@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "variant_gallery.hpp"
+#include "core/grid_pyramid.hpp"
+#include "core/result_cache.hpp"
+#include "imgui.h"
+
+using namespace gs;
+
+namespace
+{
+    // Largest side of the thumbnails in cells
+    const int thumbnail_cells = 96;
+
+    // Largest side of the thumbnails on screen, in pixels
+    const float thumbnail_pixels = 96.0f;
+}
+
+variant_gallery::variant_gallery(SDL_Renderer* renderer, synthesis_pool& pool)
+    : m_renderer(renderer), m_pool(pool)
+{
+}
+
+variant_gallery::~variant_gallery()
+{
+    cancel();
+}
+
+void variant_gallery::cancel()
+{
+    m_pool.cancel(this);
+    m_remaining = 0;
+}
+
+void variant_gallery::start(grid_synth job, std::vector<uint32_t> seeds, result_cache* cache, stage_cache* stages)
+{
+    cancel();
+
+    m_slots.clear();
+    m_slots.resize(seeds.size());
+    for (size_t i = 0; i < seeds.size(); ++i)
+        m_slots[i].seed = seeds[i];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_arrivals.clear();
+    }
+    m_done = 0;
+    m_remaining = seeds.size();
+
+    // The tasks clone the shared snapshot, so only the running ones hold a copy
+    auto shared = std::make_shared<const grid_synth>(std::move(job));
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        m_pool.submit(this, [this, shared, i, seed = seeds[i], cache, stages](const std::atomic<bool>& preempt) {
+            auto start = std::chrono::steady_clock::now();
+            grid_synth local = shared->clone();
+            local.set_seed(seed);
+
+            synthesis_control control;
+            control.cancel = &preempt;
+            control.stages = stages;
+            bool hit = false;
+            if (cache)
+                hit = synthesize_cached(local, *cache, control);
+            else
+                local.synthesize(control);
+            if (!hit && preempt)
+                return false;
+
+            // Thumbnails are made on the pool threads, only they reach the UI
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            grid thumbnail = make_thumbnail(local.get_grid(), thumbnail_cells);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_arrivals.push_back({i, elapsed.count(), std::move(thumbnail)});
+            m_done++;
+            m_remaining--;
+            return true;
+        });
+    }
+}
+
+void variant_gallery::upload()
+{
+    std::vector<arrival> arrivals;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(arrivals, m_arrivals);
+    }
+
+    for (auto& a : arrivals) {
+        slot& s = m_slots[a.index];
+        if (!s.texture)
+            s.texture = std::make_unique<grid_texture>(m_renderer);
+        s.texture->invalidate();
+        s.ready = s.texture->update(a.thumbnail);
+        s.seconds = a.seconds;
+        s.width = a.thumbnail.width();
+        s.height = a.thumbnail.height();
+    }
+}
+
+bool variant_gallery::draw(uint32_t& seed)
+{
+    upload();
+
+    const ImGuiStyle& style = ImGui::GetStyle();
+    const float cell = thumbnail_pixels + style.FramePadding.x * 2.0f;
+    const int columns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) /
+                                          (cell + style.ItemSpacing.x)));
+
+    bool clicked = false;
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        const slot& s = m_slots[i];
+        if (i % columns != 0)
+            ImGui::SameLine();
+
+        ImGui::PushID((int)i);
+        if (s.ready) {
+            const float scale = thumbnail_pixels / std::max(s.width, s.height);
+            if (ImGui::ImageButton("##variant", (ImTextureID)(intptr_t)s.texture->texture(),
+                                   ImVec2(s.width * scale, s.height * scale))) {
+                seed = s.seed;
+                clicked = true;
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Seed %u, %.2fs\nClick to use this seed", s.seed, s.seconds);
+            }
+        } else {
+            ImGui::Button("...", ImVec2(cell, cell));
+        }
+        ImGui::PopID();
+    }
+    return clicked;
+}
+
+size_t variant_gallery::bytes() const
+{
+    size_t total = 0;
+    for (const auto& s : m_slots)
+        if (s.texture)
+            total += s.texture->bytes();
+    return total;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core/grid_synth.hpp"
+#include "core/synthesis_pool.hpp"
+#include "grid_texture.hpp"
+
+namespace gs
+{
+
+class result_cache;
+class stage_cache;
+
+////////////////////////////////////////////////////////////////////////////////
+////                           variant_gallery
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Thumbnails of a pipeline synthesized with many seeds
+///
+/// Every seed is a task of a synthesis_pool shared with the galleries of the
+/// other documents, owned by the gallery. The pool threads turn every result
+/// into a thumbnail as soon as it is done. The UI thread uploads the
+/// thumbnails that arrived since the last frame, so the gallery fills in
+/// while the batch runs. Starting a new batch cancels the running one.
+class variant_gallery
+{
+public:
+    /// @brief Constructor
+    /// @param renderer SDL renderer for the thumbnail textures, may be null
+    /// @param pool Pool running the seeds, must outlive the gallery
+    variant_gallery(SDL_Renderer* renderer, synthesis_pool& pool);
+
+    /// @brief Destructor, cancels the running batch
+    ~variant_gallery();
+
+    variant_gallery(const variant_gallery&) = delete;
+    variant_gallery& operator=(const variant_gallery&) = delete;
+
+    /// @brief Start synthesizing a batch, cancelling the running one
+    /// @param job Snapshot of the synthesizer to run
+    /// @param seeds The seeds to run, one thumbnail each
+    /// @param cache Optional result cache, so an adopted seed is not run again
+    /// @param stages Optional stage output cache, so a seed preempted by the
+    ///        pool resumes after its last finished stage
+    void start(grid_synth job, std::vector<uint32_t> seeds,
+               result_cache* cache = nullptr, stage_cache* stages = nullptr);
+
+    /// @brief Cancel the running batch and wait for it to stop
+    void cancel();
+
+    /// @brief Give the seeds of this gallery priority in the pool over the
+    /// galleries of the other documents
+    void focus() { m_pool.set_foreground(this); }
+
+    /// @brief Check if a batch is running
+    bool busy() const { return m_remaining > 0; }
+
+    /// @brief Get the number of finished thumbnails
+    size_t done() const { return m_done; }
+
+    /// @brief Get the number of seeds of the batch
+    size_t size() const { return m_slots.size(); }
+
+    /// @brief Draw the thumbnails wrapped to the width of the window
+    /// @param seed Receives the seed of a clicked thumbnail
+    /// @return True if a thumbnail was clicked
+    bool draw(uint32_t& seed);
+
+    /// @brief Get the memory used by the thumbnails and their textures
+    /// @return Size in bytes
+    size_t bytes() const;
+
+private:
+    struct slot {
+        uint32_t seed;
+        bool ready = false;
+        double seconds = 0.0;
+        int width = 0;
+        int height = 0;
+        std::unique_ptr<grid_texture> texture;
+    };
+
+    /// @brief Finished result waiting to be uploaded
+    struct arrival {
+        size_t index;
+        double seconds;
+        grid thumbnail;
+    };
+
+    void upload();
+
+    SDL_Renderer* m_renderer;
+    synthesis_pool& m_pool;
+    std::vector<slot> m_slots;
+
+    std::atomic<size_t> m_remaining{0};
+    std::atomic<size_t> m_done{0};
+
+    std::mutex m_mutex;
+    std::vector<arrival> m_arrivals;    ///< Guarded by m_mutex
+};
+
+}
@@ -3,9 +3,239 @@
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_sdlrenderer3.h"
 #include "editor/editor.hpp"
+#include "core/archive.hpp"
+#include "core/batch.hpp"
+#include "core/file_watcher.hpp"
+#include "core/hash.hpp"
+#include "core/image.hpp"
+#include "core/result_cache.hpp"
+#include "core/stage_cache.hpp"
+#include "core/tilemap.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
 #include <stdio.h>
 
+static void print_usage(const char* program)
+{
+    printf("Usage: %s [project.json...] [--watch]\n", program);
+    printf("       %s --headless project.json --output file [--watch]\n", program);
+    printf("       %s --headless project.json --seeds count [--archive file.gsa] [--dir directory]\n", program);
+    printf("\n");
+    printf("  --watch       Reload the projects whenever their file changes\n");
+    printf("  --headless    Synthesize without a window\n");
+    printf("  -o, --output  Image (.png, .ppm) or tilemap (.tmx, .csv) to write\n");
+    printf("  --seeds       Synthesize this many seeds, from the seed of the project up\n");
+    printf("  --archive     Archive the seeds are appended to\n");
+    printf("  --dir         Directory receiving one file per seed\n");
+    printf("  --format      Format of those files: png (default), ppm, tmx or csv\n");
+}
+
+// Read a project file, printing the error if it fails
+static bool load_project(const std::string& project, gs::grid_synth& synth)
+{
+    try {
+        std::ifstream file(project);
+        if (!file.is_open())
+            throw std::runtime_error("Could not open file for reading: " + project);
+        synth = gs::grid_synth::from_json(nlohmann::json::parse(file));
+        return true;
+    }
+    catch (const std::exception& e) {
+        printf("Error: %s\n", e.what());
+        return false;
+    }
+}
+
+// Synthesize a project without a window, and again whenever it changes when
+// watching. Stage outputs are kept between runs, so an edit to the pipeline
+// only reruns the stages from the first changed one. Finished grids go to the
+// on-disk result cache, so rebuilding an unchanged project does not run it.
+static int run_headless(const std::string& project, const std::string& output, bool watch)
+{
+    gs::result_cache cache(gs::result_cache::default_directory());
+    gs::stage_cache stages;
+    gs::file_watcher watcher;
+    if (watch && !watcher.watch(project))
+        return 1;
+
+    std::unique_ptr<gs::grid_synth> previous;
+    uint64_t previous_input = 0;
+    do {
+        gs::grid_synth synth(0, 0);
+        if (!load_project(project, synth)) {
+            if (!watch)
+                return 1;
+            continue;
+        }
+
+        const gs::grid& input = synth.get_grid();
+        const uint64_t input_hash = gs::hash_bytes(input.raw_data(), (size_t)input.width() * input.height() * sizeof(int),
+                                                   gs::hash_combine(input.width(), input.height()));
+        const size_t count = synth.get_transformations().size();
+        size_t first = 0;
+        if (previous) {
+            first = synth.first_changed_stage(*previous);
+            if (first >= std::max(count, previous->get_transformations().size()) && input_hash == previous_input) {
+                printf("%s: unchanged\n", project.c_str());
+                continue;
+            }
+        }
+
+        std::vector<gs::stage_profile> profile;
+        gs::synthesis_control control;
+        control.stages = &stages;
+        control.profile = &profile;
+        gs::grid_synth job = synth.clone();
+        auto start = std::chrono::steady_clock::now();
+        const bool hit = gs::synthesize_cached(job, cache, control);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        bool saved;
+        if (output.find(".tmx") != std::string::npos || output.find(".csv") != std::string::npos) {
+            gs::tilemap_options options;
+            options.format = gs::tilemap_format_from_filename(output);
+            saved = gs::save_tilemap(output, job.get_grid(), gs::tile_mapping::from_alphabet(*job.get_alphabet()), options);
+        } else {
+            saved = gs::save_image(output, job.get_grid(), gs::palette::from_alphabet(*job.get_alphabet()));
+        }
+        if (!saved) {
+            printf("Error: could not write %s\n", output.c_str());
+            if (!watch)
+                return 1;
+        }
+
+        size_t reused = std::count_if(profile.begin(), profile.end(), [](const gs::stage_profile& p) { return p.cached; });
+        if (hit)
+            printf("%s: result cache hit, %.3fs\n", project.c_str(), seconds.count());
+        else
+            printf("%s: changed from stage %zu, %zu of %zu stages reused, %.3fs\n",
+                   project.c_str(), std::min(first, count) + 1, reused, profile.size(), seconds.count());
+
+        previous = std::make_unique<gs::grid_synth>(std::move(synth));
+        previous_input = input_hash;
+    } while (watch && watcher.wait());
+
+    return 0;
+}
+
+// Synthesize many seeds of a project on all cores into an archive, one file
+// per seed in a directory, or both. Seeds already in the result cache are not
+// run again.
+static int run_batch(const std::string& project, int count, const std::string& archive,
+                     const std::string& directory, const std::string& format)
+{
+    gs::grid_synth synth(0, 0);
+    if (!load_project(project, synth))
+        return 1;
+
+    std::vector<uint32_t> seeds;
+    for (int i = 0; i < count; ++i)
+        seeds.push_back(synth.seed() + (uint32_t)i);
+
+    std::vector<gs::batch_sink> sinks;
+    std::unique_ptr<gs::archive_writer> writer;
+    if (!archive.empty()) {
+        try {
+            writer = std::make_unique<gs::archive_writer>(archive);
+        }
+        catch (const std::exception& e) {
+            printf("Error: %s\n", e.what());
+            return 1;
+        }
+        sinks.push_back(gs::archive_sink(*writer));
+    }
+    if (!directory.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (ec) {
+            printf("Error: could not create %s\n", directory.c_str());
+            return 1;
+        }
+        const std::string filename = "seed." + format;
+        if (format == "tmx" || format == "csv") {
+            gs::tilemap_options options;
+            options.format = gs::tilemap_format_from_filename(filename);
+            sinks.push_back(gs::tilemap_sink(directory, gs::tile_mapping::from_alphabet(*synth.get_alphabet()), options));
+        } else {
+            sinks.push_back(gs::image_sink(directory, gs::image_format_from_filename(filename),
+                                           gs::palette::from_alphabet(*synth.get_alphabet())));
+        }
+    }
+
+    gs::result_cache cache(gs::result_cache::default_directory());
+    std::atomic<size_t> hits{0};
+    auto start = std::chrono::steady_clock::now();
+    gs::synthesize_batch(synth, seeds, [&](const gs::batch_result& result) {
+        for (const auto& sink : sinks)
+            sink(result);
+        if (result.cache_hit)
+            hits++;
+    }, 0, &cache);
+    if (writer)
+        writer->finish();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    printf("%s: %zu seeds written, %zu from the result cache, %.3fs\n",
+           project.c_str(), seeds.size(), hits.load(), seconds.count());
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    // Command line
+    std::vector<std::string> projects;
+    std::string output;
+    std::string archive;
+    std::string directory;
+    std::string format = "png";
+    int seeds = 0;
+    bool headless = false;
+    bool watch = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--seeds" && i + 1 < argc) {
+            seeds = std::atoi(argv[++i]);
+        } else if (arg == "--archive" && i + 1 < argc) {
+            archive = argv[++i];
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg[0] != '-') {
+            projects.push_back(arg);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (headless) {
+        const bool known_format = format == "png" || format == "ppm" || format == "tmx" || format == "csv";
+        if (projects.size() == 1 && seeds > 0 && (!archive.empty() || !directory.empty()) && known_format &&
+            output.empty() && !watch)
+            return run_batch(projects[0], seeds, archive, directory, format);
+        if (projects.size() != 1 || output.empty() || seeds > 0 || !archive.empty() || !directory.empty()) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return run_headless(projects[0], output, watch);
+    }
+
     // Setup SDL
     if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD))
     {
@@ -48,7 +278,9 @@ int main(int argc, char* argv[]) {
     ImGui_ImplSDLRenderer3_Init(renderer);
 
     // Load Fonts
-    gs::editor editor;
+    gs::editor editor(renderer);
+    for (const auto& project : projects)
+        editor.open(project, watch);
 
     // Our state
     bool show_demo_window = false;
@@ -56,22 +288,35 @@ int main(int argc, char* argv[]) {
 
     // Main loop
     bool done = false;
+    int frames_to_render = 3;   // ImGui needs a few frames to settle after input
+    auto process_event = [&](const SDL_Event& event)
+    {
+        ImGui_ImplSDL3_ProcessEvent(&event);
+        if (event.type == SDL_EVENT_QUIT)
+            done = true;
+        if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && event.window.windowID == SDL_GetWindowID(window))
+            done = true;
+        frames_to_render = 3;
+    };
     while (!done)
     {
+        // Sleep until there is input unless something is animating or running in the background
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        bool minimized = (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) != 0;
+        if (minimized || (frames_to_render <= 0 && !editor.wants_continuous_update()))
         {
-            ImGui_ImplSDL3_ProcessEvent(&event);
-            if (event.type == SDL_EVENT_QUIT)
-                done = true;
-            if (event.type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && event.window.windowID == SDL_GetWindowID(window))
-                done = true;
+            // Wake up regularly anyway so a blinking text cursor keeps blinking
+            int timeout_ms = io.WantTextInput ? 250 : 1000;
+            if (SDL_WaitEventTimeout(&event, timeout_ms))
+                process_event(event);
+            else
+                frames_to_render = 1;
         }
+        while (SDL_PollEvent(&event))
+            process_event(event);
         if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED)
-        {
-            SDL_Delay(10);
             continue;
-        }
+        frames_to_render--;
 
         // Start the Dear ImGui frame
         ImGui_ImplSDLRenderer3_NewFrame();
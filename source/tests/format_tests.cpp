@@ -0,0 +1,321 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "core/archive.hpp"
+#include "core/deflate.hpp"
+#include "core/grid_io.hpp"
+#include "core/image.hpp"
+#include "core/palette.hpp"
+
+// Round trips of the file formats: deflate and zlib streams, PNG and PPM
+// images, compressed and binary grids and grid archives. Every case writes
+// data, reads it back and compares, a few check that corrupt input is
+// rejected. Returns non-zero if any case fails.
+
+using namespace gs;
+namespace fs = std::filesystem;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& name)
+    {
+        if (!ok) {
+            std::printf("FAIL %s\n", name.c_str());
+            failures++;
+        }
+    }
+
+    // Runs a case, an exception counts as a failure
+    void run(const std::string& name, const std::function<bool()>& fn)
+    {
+        try {
+            check(fn(), name);
+        } catch (const std::exception& e) {
+            std::printf("FAIL %s: %s\n", name.c_str(), e.what());
+            failures++;
+        }
+    }
+
+    // Runs of repeated bytes mixed with noise, so both literals and matches
+    // are encoded
+    std::vector<uint8_t> test_bytes(size_t size)
+    {
+        std::mt19937 rng((uint32_t)size);
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size;) {
+            size_t run = 1 + rng() % 40;
+            uint8_t value = (uint8_t)rng();
+            bool noise = rng() % 2 == 0;
+            for (size_t j = 0; j < run && i < size; ++j, ++i)
+                data[i] = noise ? (uint8_t)rng() : value;
+        }
+        return data;
+    }
+
+    // Source reading a buffer a few bytes at a time
+    byte_source buffer_source(const std::vector<uint8_t>& data, size_t& position)
+    {
+        return [&data, &position](uint8_t* buffer, size_t capacity) {
+            size_t n = std::min({capacity, data.size() - position, (size_t)777});
+            std::memcpy(buffer, data.data() + position, n);
+            position += n;
+            return n;
+        };
+    }
+
+    std::vector<int> symbol_ids(const alphabet& a)
+    {
+        std::vector<int> ids = {alphabet::empty_symbol.id, alphabet::wildcard_symbol.id};
+        for (const auto& s : a.get_symbols())
+            ids.push_back(s.id);
+        return ids;
+    }
+
+    grid test_grid(int width, int height, const std::vector<int>& ids, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        grid g(width, height);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                g(x, y) = rng() % 4 == 0 ? ids[rng() % ids.size()] : ids[(x / 5 + y / 3) % ids.size()];
+        return g;
+    }
+
+    bool same(const grid& a, const grid& b)
+    {
+        if (a.width() != b.width() || a.height() != b.height())
+            return false;
+        for (int y = 0; y < a.height(); ++y)
+            for (int x = 0; x < a.width(); ++x)
+                if (a(x, y) != b(x, y))
+                    return false;
+        return true;
+    }
+
+    void test_deflate()
+    {
+        const std::pair<deflate_mode, const char*> modes[] = {
+            {deflate_mode::store, "store"}, {deflate_mode::fixed, "fixed"}};
+        for (const auto& [mode, mode_name] : modes) {
+            for (size_t size : {0, 1, 100, 70000}) {
+                const std::vector<uint8_t> data = test_bytes(size);
+                const std::string name = std::string(mode_name) + " " + std::to_string(size);
+
+                run("deflate " + name, [&]() {
+                    std::vector<uint8_t> compressed = deflate(data.data(), data.size(), mode);
+                    std::vector<uint8_t> out;
+                    size_t position = 0;
+                    inflate(buffer_source(compressed, position),
+                            [&](const uint8_t* p, size_t n) { out.insert(out.end(), p, p + n); });
+                    return out == data;
+                });
+
+                run("zlib " + name, [&]() {
+                    std::vector<uint8_t> compressed = zlib_compress(data.data(), data.size(), mode);
+                    return zlib_decompress(compressed.data(), compressed.size()) == data;
+                });
+
+                run("deflater " + name, [&]() {
+                    std::vector<uint8_t> compressed;
+                    {
+                        deflater d([&](const uint8_t* p, size_t n) { compressed.insert(compressed.end(), p, p + n); },
+                                   mode);
+                        for (size_t i = 0; i < data.size(); i += 1000)
+                            d.write(data.data() + i, std::min<size_t>(1000, data.size() - i));
+                        d.finish();
+                    }
+                    return zlib_decompress(compressed.data(), compressed.size()) == data;
+                });
+            }
+        }
+    }
+
+    void test_images()
+    {
+        alphabet a;
+        for (int id = 1; id <= 6; ++id)
+            a.add_symbol({id, "S" + std::to_string(id)});
+        const palette p = palette::from_alphabet(a);
+        const grid g = test_grid(37, 23, symbol_ids(a), 1);
+
+        for (int scale : {1, 3}) {
+            for (deflate_mode mode : {deflate_mode::store, deflate_mode::fixed}) {
+                const std::string name = "png scale " + std::to_string(scale) +
+                                         (mode == deflate_mode::store ? " store" : " fixed");
+                run(name, [&]() {
+                    image_options options;
+                    options.scale = scale;
+                    options.compression = mode;
+                    std::stringstream stream;
+                    write_png(stream, g, p, options);
+                    image_import_options import;
+                    import.scale = scale;
+                    import.strict = true;
+                    return same(read_png(stream, p, import), g);
+                });
+            }
+
+            run("ppm scale " + std::to_string(scale), [&]() {
+                image_options options;
+                options.scale = scale;
+                std::stringstream stream;
+                write_ppm(stream, g, p, options);
+                image_import_options import;
+                import.scale = scale;
+                import.strict = true;
+                return same(read_ppm(stream, p, import), g);
+            });
+        }
+
+        // More symbols than the nice colors tell apart
+        run("png 1000 symbols", [&]() {
+            alphabet large;
+            for (int id = 1; id <= 1000; ++id)
+                large.add_symbol({id, "S" + std::to_string(id)});
+            const palette lp = palette::from_alphabet(large);
+            const grid lg = test_grid(100, 10, symbol_ids(large), 2);
+            std::stringstream stream;
+            write_png(stream, lg, lp);
+            image_import_options import;
+            import.strict = true;
+            return same(read_png(stream, lp, import), lg);
+        });
+
+        // Header values past INT32_MAX must be rejected, not overflow
+        run("ppm oversized header", [&]() {
+            std::stringstream stream("P6\n99999999999 1\n255\n");
+            try {
+                read_ppm(stream, p);
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        });
+
+        // Chunks other than the header and palette are skipped, whatever
+        // their claimed length
+        run("png large ancillary chunk", [&]() {
+            std::stringstream stream;
+            write_png(stream, g, p);
+            std::string data = stream.str();
+            const char chunk[] = {'\x7f', '\xff', '\xff', '\xff', 't', 'E', 'X', 't'};
+            data.insert(8, chunk, sizeof(chunk));
+            std::stringstream truncated(data);
+            try {
+                read_png(truncated, p);
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        });
+    }
+
+    void test_grids()
+    {
+        const std::vector<int> ids = {0, -1, 1, 2, 1000000, -70000};
+        for (auto [width, height] : {std::pair<int, int>{0, 0}, {1, 1}, {64, 48}, {513, 7}}) {
+            const grid g = test_grid(width, height, ids, 3);
+            const std::string size = std::to_string(width) + "x" + std::to_string(height);
+
+            run("compressed grid " + size, [&]() {
+                std::vector<uint8_t> data = compress_grid(g);
+                return same(decompress_grid(data.data(), data.size()), g);
+            });
+
+            run("binary grid " + size, [&]() {
+                std::stringstream stream;
+                write_grid_binary(stream, g);
+                return same(read_grid_binary(stream), g);
+            });
+        }
+    }
+
+    void test_archive()
+    {
+        const std::string filename = (fs::temp_directory_path() / "grid_synth_format_tests.gsa").string();
+        std::error_code ec;
+        fs::remove(filename, ec);
+
+        const std::vector<int> ids = {0, 1, 2, 3};
+        std::vector<grid> grids;
+        for (uint32_t seed = 0; seed < 20; ++seed)
+            grids.push_back(test_grid(10 + seed, 30 - seed, ids, seed));
+
+        run("archive", [&]() {
+            {
+                archive_writer writer(filename);
+                for (uint32_t seed = 0; seed < 12; ++seed)
+                    writer.append(seed, grids[seed], 0.5f);
+                writer.finish();
+            }
+
+            // Appending to an existing archive keeps its entries
+            {
+                archive_writer writer(filename);
+                for (uint32_t seed = 12; seed < grids.size(); ++seed)
+                    writer.append(seed, grids[seed]);
+                writer.finish();
+            }
+
+            archive_reader reader(filename);
+            if (reader.size() != grids.size() || reader.find(1000) != nullptr)
+                return false;
+            for (uint32_t seed = 0; seed < grids.size(); ++seed) {
+                const archive_entry* entry = reader.find(seed);
+                if (!entry || !same(reader.load(*entry), grids[seed]))
+                    return false;
+            }
+            return true;
+        });
+
+        // An index offset near UINT64_MAX must be rejected, not wrap around
+        run("archive corrupt footer", [&]() {
+            {
+                archive_writer writer(filename);
+                writer.append(0, grids[0]);
+                writer.finish();
+            }
+            {
+                const uint64_t offset = UINT64_MAX - 7;
+                uint8_t bytes[8];
+                for (int i = 0; i < 8; ++i)
+                    bytes[i] = (uint8_t)(offset >> (8 * i));
+                std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekp(-12, std::ios::end);
+                file.write((const char*)bytes, 8);
+            }
+            try {
+                archive_reader reader(filename);
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        });
+
+        fs::remove(filename, ec);
+    }
+}
+
+int main()
+{
+    test_deflate();
+    test_images();
+    test_grids();
+    test_archive();
+
+    if (failures > 0) {
+        std::printf("%d failed\n", failures);
+        return 1;
+    }
+    std::printf("All format round trips passed\n");
+    return 0;
+}